@@ -0,0 +1,293 @@
+/*
+ * Checkpoint file shared by the process generator and the scheduler.
+ * Include it after headers.h.
+ *
+ * The file is mmap'd by both sides. The generator owns the header (its command
+ * line and arrival cursor), the scheduler writes its state into one of two slots,
+ * always the one that isn't the latest, so a crash in the middle of a snapshot
+ * never damages the previous one.
+ *
+ * A slot holds as many PCBs as its capacity. When a snapshot needs more, the slot
+ * being written moves to a bigger region at the end of the file, the latest one
+ * stays where it is.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <string.h>
+
+#define CHECKPOINT_FILE "simulation.ckpt"
+#define CHECKPOINT_MAGIC 0x4b435053     // "SPCK"
+#define CHECKPOINT_VERSION 8
+#define CHECKPOINT_INITIAL_PCBS 1024
+#define CHECKPOINT_MAX_ARGS 32
+#define CHECKPOINT_ARG_LEN 128
+#define CHECKPOINT_TUNER_WINDOW 64
+#define CHECKPOINT_WAIT_LEVELS 32
+
+// Where a PCB was when the snapshot was taken
+typedef enum {
+    CKPT_RUNNING,
+    CKPT_READY,
+    CKPT_PENDING,       // waiting for memory
+    CKPT_IO             // blocked on I/O
+} CheckpointQueue;
+
+// PCB without pointers or pids, those don't survive a restart
+typedef struct {
+    int id;
+    int arrivalTime;
+    int runtime;
+    int priority;
+    int remainingTime;
+    int waitingTime;
+    int executionTime;
+    int startTime;
+    int lastStopTime;
+    int memsize;
+    int memStart;
+    int memOrder;
+    int bursts[MAX_BURSTS];
+    int burstCount;
+    int burstIndex;
+    int burstRemaining;
+    int ioTime;
+    int ioWakeTime;
+    int readySince;
+    int started;
+    int queue;
+} CheckpointPCB;
+
+typedef struct {
+    volatile int complete;      // cleared while the slot is being written
+    int seq;
+    int clock;
+    int received;               // processes received so far, the generator resumes from here
+    int allArrived;
+    int quantumCounter;
+    // Metric accumulators
+    long long totalWaitingTime;
+    long long totalRuntime;
+    double totalWTA;
+    double totalWTASquared;
+    int finishedCount;
+    int cpuBusyTicks;
+    int ioBusyTicks;
+    int overlapTicks;
+    int peakAllocatedBytes;
+    int memoryAllocations;
+    int memoryFailures;
+    int memoryRejected;
+    int switchBusy;
+    int overheadTicks;
+    int contextSwitches;
+    // Adaptive Round Robin
+    int quantum;
+    int quantumChanges;
+    int tunerCount;
+    int tunerNext;
+    int tunerSamples[CHECKPOINT_TUNER_WINDOW];
+    // Starvation statistics
+    int maxReadyWait;
+    int maxReadyWaitId;
+    int maxWaitByPriority[CHECKPOINT_WAIT_LEVELS];
+    int minPrioritySeen;
+    int maxPrioritySeen;
+    // Current rolling window
+    int windowStart;
+    int windowFinished;
+    double windowTotalWTA;
+    double windowMaxWTA;
+    long long windowTotalWaiting;
+    int windowBusyTicksAtStart;
+    // Latency histograms, the clock's jitter includes that of earlier clocks
+    LatencyHistogram jitter;
+    LatencyHistogram dispatchLatency;
+    // Running process first, then ready queue, pending queue and I/O in queue order
+    int pcbCount;
+    CheckpointPCB pcbs[];
+} SchedulerCheckpoint;
+
+typedef struct {
+    int magic;
+    int version;
+    // Generator
+    int algorithm;
+    int quantum;
+    int argc;                   // generator flags without --restore
+    char argv[CHECKPOINT_MAX_ARGS][CHECKPOINT_ARG_LEN];
+    int arrivalCursor;          // processes sent so far
+    // Scheduler
+    volatile int latest;        // slot holding the newest complete snapshot, -1 if none
+    long slotOffset[2];         // where each slot starts in the file
+    int slotCapacity[2];        // PCBs each slot has room for
+} Checkpoint;
+
+// Mapping of this process, the file may grow under the generator's older one
+int checkpointFd = -1;
+size_t checkpointMapped = 0;
+
+/* Bytes taken by a slot with room for capacity PCBs, kept 8 byte aligned */
+size_t snapshotBytes(int capacity)
+{
+    size_t bytes = sizeof(SchedulerCheckpoint) + (size_t)capacity * sizeof(CheckpointPCB);
+    return (bytes + 7) & ~(size_t)7;
+}
+
+SchedulerCheckpoint* snapshotSlot(Checkpoint* ckpt, int index)
+{
+    return (SchedulerCheckpoint*)((char*)ckpt + ckpt->slotOffset[index]);
+}
+
+
+/*
+ * Map the checkpoint file at path. With reset the file is (re)initialized for a new run,
+ * otherwise it must already hold a valid checkpoint.
+ * Returns NULL on failure.
+ */
+Checkpoint* openCheckpoint(const char* path, bool reset)
+{
+    int fd = open(path, reset ? (O_RDWR | O_CREAT) : O_RDWR, 0644);
+    if (fd == -1)
+    {
+        perror("Error opening checkpoint file");
+        return NULL;
+    }
+    size_t initial = sizeof(Checkpoint) + 2 * snapshotBytes(CHECKPOINT_INITIAL_PCBS);
+    if (reset && (ftruncate(fd, 0) == -1 || ftruncate(fd, initial) == -1))
+    {
+        perror("Error sizing checkpoint file");
+        close(fd);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(Checkpoint))
+    {
+        printf("Checkpoint file is missing or truncated!\n");
+        close(fd);
+        return NULL;
+    }
+
+    Checkpoint* ckpt = (Checkpoint*)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED, fd, 0);
+    if (ckpt == MAP_FAILED)
+    {
+        perror("Error mapping checkpoint file");
+        close(fd);
+        return NULL;
+    }
+
+    if (reset)
+    {
+        memset(ckpt, 0, sizeof(Checkpoint));
+        ckpt->magic = CHECKPOINT_MAGIC;
+        ckpt->version = CHECKPOINT_VERSION;
+        ckpt->latest = -1;
+        for (int i = 0; i < 2; i++)
+        {
+            ckpt->slotOffset[i] = sizeof(Checkpoint) + i * snapshotBytes(CHECKPOINT_INITIAL_PCBS);
+            ckpt->slotCapacity[i] = CHECKPOINT_INITIAL_PCBS;
+        }
+    }
+    else
+    {
+        bool valid = ckpt->magic == CHECKPOINT_MAGIC && ckpt->version == CHECKPOINT_VERSION;
+        for (int i = 0; valid && i < 2; i++)
+        {
+            valid = ckpt->slotOffset[i] >= (long)sizeof(Checkpoint) && ckpt->slotCapacity[i] >= 0 &&
+                    ckpt->slotOffset[i] + snapshotBytes(ckpt->slotCapacity[i]) <= (size_t)st.st_size;
+        }
+        if (!valid)
+        {
+            printf("Checkpoint file has the wrong format!\n");
+            munmap(ckpt, st.st_size);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    checkpointFd = fd;
+    checkpointMapped = st.st_size;
+    return ckpt;
+}
+
+void closeCheckpoint(Checkpoint* ckpt)
+{
+    msync(ckpt, checkpointMapped, MS_SYNC);
+    munmap(ckpt, checkpointMapped);
+    close(checkpointFd);
+    checkpointFd = -1;
+    checkpointMapped = 0;
+}
+
+/* Newest complete scheduler snapshot or NULL */
+SchedulerCheckpoint* latestSnapshot(Checkpoint* ckpt)
+{
+    if (ckpt->latest < 0 || ckpt->latest > 1 || !snapshotSlot(ckpt, ckpt->latest)->complete)
+    {
+        return NULL;
+    }
+    return snapshotSlot(ckpt, ckpt->latest);
+}
+
+/*
+ * Slot to write the next snapshot of pcbs PCBs into, marked incomplete until
+ * published. A slot that is too small is moved to the end of the grown file,
+ * which remaps it, so *ckpt may change. Returns NULL if the file can't grow.
+ */
+SchedulerCheckpoint* beginSnapshot(Checkpoint** ckpt, int pcbs)
+{
+    int index = ((*ckpt)->latest == 0) ? 1 : 0;
+
+    if ((*ckpt)->slotCapacity[index] < pcbs)
+    {
+        int capacity = (*ckpt)->slotCapacity[index] * 2;
+        while (capacity < pcbs)
+        {
+            capacity *= 2;
+        }
+        size_t offset = checkpointMapped;
+        size_t size = offset + snapshotBytes(capacity);
+        if (ftruncate(checkpointFd, size) == -1)
+        {
+            perror("Error growing checkpoint file");
+            return NULL;
+        }
+        Checkpoint* grown = (Checkpoint*)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED, checkpointFd, 0);
+        if (grown == MAP_FAILED)
+        {
+            perror("Error mapping checkpoint file");
+            return NULL;
+        }
+        munmap(*ckpt, checkpointMapped);
+        *ckpt = grown;
+        checkpointMapped = size;
+
+        // Only the slot that isn't the latest moves, so a crash here loses nothing
+        grown->slotOffset[index] = offset;
+        grown->slotCapacity[index] = capacity;
+    }
+
+    SchedulerCheckpoint* slot = snapshotSlot(*ckpt, index);
+    slot->complete = 0;
+    __sync_synchronize();
+    return slot;
+}
+
+void publishSnapshot(Checkpoint* ckpt, SchedulerCheckpoint* slot)
+{
+    SchedulerCheckpoint* previous = latestSnapshot(ckpt);
+    slot->seq = (previous != NULL) ? previous->seq + 1 : 1;
+    __sync_synchronize();
+    slot->complete = 1;
+    __sync_synchronize();
+    ckpt->latest = ((char*)slot - (char*)ckpt == ckpt->slotOffset[1]) ? 1 : 0;
+    msync(ckpt, checkpointMapped, MS_ASYNC);
+}
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // CPU affinity and SCHED_RESET_ON_FORK
+#endif
 #include <stdio.h>      //if you don't use scanf/printf change this include
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -10,14 +13,248 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
 
 #include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 
 // typedef short bool;
 // #define true 1
 // #define false 1
 
 #define SHKEY 300
+#define MSGKEY_PROJ 'M'
+
+// Environment variable naming the simulation instance, see runKey()
+#define RUN_ID_ENV "SIM_RUN_ID"
+
+// Environment variable holding "clockCpu,schedulerCpu,priority" in real-time mode, see enterRealtime()
+#define REALTIME_ENV "SIM_REALTIME"
+
+// Latency histograms have power of two buckets in microseconds: <1, 1-2, 2-4, ...
+#define LATENCY_BUCKETS 24
+
+// Max number of alternating CPU/IO bursts per process (CPU, IO, CPU, ... , CPU)
+#define MAX_BURSTS 15
+// Longest I/O burst, the scheduler's timer wheel holds wakeups up to 2^24 ticks ahead
+#define MAX_IO_BURST ((1 << 24) - 1)
+
+
+/*
+ * Several simulations can share a host when each one has its own run ID.
+ * Every IPC key is derived from the ID (FNV-1a hash mixed with the base key),
+ * without an ID the fixed keys of a single simulation are used.
+*/
+key_t runKey(int base)
+{
+    const char* runId = getenv(RUN_ID_ENV);
+    if (runId == NULL || runId[0] == '\0')
+    {
+        return base;
+    }
+
+    unsigned int hash = 2166136261u;
+    for (const char* c = runId; *c != '\0'; c++)
+    {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    key_t key = (key_t)((hash ^ (unsigned int)base) & 0x7fffffff);
+    return (key == IPC_PRIVATE) ? base : key;
+}
+
+/*
+ * Path of a sibling binary, looked up next to the running executable so the
+ * simulation doesn't depend on the current directory.
+*/
+void binaryPath(char* path, size_t size, const char* name)
+{
+    char self[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len <= 0)
+    {
+        snprintf(path, size, "./%s", name);
+        return;
+    }
+    self[len] = '\0';
+
+    char* slash = strrchr(self, '/');
+    *slash = '\0';
+    snprintf(path, size, "%s/%s", self, name);
+}
+
+
+typedef struct
+{
+    long long count;
+    long long buckets[LATENCY_BUCKETS];
+    double totalNs;
+    double maxNs;
+} LatencyHistogram;
+
+/*
+ * The clock's shared memory. Everyone reads the tick through getClk(), the
+ * rest is written by the clock on every tick: when it happened and how late
+ * the clock woke up for it.
+*/
+typedef struct
+{
+    int clock;
+    int reserved;
+    long long tickNs;           // CLOCK_MONOTONIC time of the latest tick
+    LatencyHistogram jitter;    // clock wakeup minus tick deadline
+} ClockShared;
+
+typedef struct
+{
+    int clockCpu;
+    int schedulerCpu;
+    int priority;
+} RealtimeConfig;
+
+long long monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void histogramAdd(LatencyHistogram* h, double ns)
+{
+    int bucket = 0;
+    long long us = (long long)(ns / 1000);
+    while (us > 0 && bucket < LATENCY_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    h->buckets[bucket]++;
+    h->count++;
+    h->totalNs += ns;
+    if (ns > h->maxNs)
+    {
+        h->maxNs = ns;
+    }
+}
+
+/* Add the samples of from into into */
+void histogramMerge(LatencyHistogram* into, const LatencyHistogram* from)
+{
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        into->buckets[i] += from->buckets[i];
+    }
+    into->count += from->count;
+    into->totalNs += from->totalNs;
+    if (from->maxNs > into->maxNs)
+    {
+        into->maxNs = from->maxNs;
+    }
+}
+
+void histogramWrite(FILE* file, const char* name, LatencyHistogram* h)
+{
+    fprintf(file, "%s = avg %.2f us, max %.2f us over %lld\n", name,
+            (h->count > 0) ? h->totalNs / h->count / 1000 : 0, h->maxNs / 1000, h->count);
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        if (h->buckets[i] == 0)
+        {
+            continue;
+        }
+        if (i == 0)
+        {
+            fprintf(file, "  < 1 us: %lld\n", h->buckets[i]);
+        }
+        else
+        {
+            fprintf(file, "  %lld-%lld us: %lld\n", 1LL << (i - 1), 1LL << i, h->buckets[i]);
+        }
+    }
+}
+
+/* Real-time settings of this simulation, false when it runs as normal tasks */
+bool realtimeConfig(RealtimeConfig* rt)
+{
+    const char* spec = getenv(REALTIME_ENV);
+    return spec != NULL &&
+           sscanf(spec, "%d,%d,%d", &rt->clockCpu, &rt->schedulerCpu, &rt->priority) == 3;
+}
+
+/*
+ * Pin the caller to cpu (-1 leaves it unpinned), run it SCHED_FIFO at priority
+ * (clamped to the SCHED_FIFO range) and lock its memory. Without the privileges
+ * for SCHED_FIFO a nice level of -10 is tried instead. Children go back to
+ * SCHED_OTHER on fork, leaveRealtime() undoes the rest.
+*/
+void enterRealtime(const char* who, int cpu, int priority)
+{
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == -1)
+        {
+            printf("%s: can't pin to CPU %d: %s\n", who, cpu, strerror(errno));
+        }
+    }
+
+    int lowest = sched_get_priority_min(SCHED_FIFO);
+    int highest = sched_get_priority_max(SCHED_FIFO);
+    if (priority < lowest || priority > highest)
+    {
+        int clamped = (priority < lowest) ? lowest : highest;
+        printf("%s: real-time priority %d is outside %d-%d, using %d\n",
+               who, priority, lowest, highest, clamped);
+        priority = clamped;
+    }
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) == -1)
+    {
+        printf("%s: SCHED_FIFO not permitted (%s), trying nice -10\n", who, strerror(errno));
+        if (setpriority(PRIO_PROCESS, 0, -10) == -1)
+        {
+            printf("%s: running at normal priority\n", who);
+        }
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+    {
+        printf("%s: can't lock memory: %s\n", who, strerror(errno));
+    }
+}
+
+/*
+ * Keep a forked child off the cores reserved for the clock and the scheduler
+ * and drop what it inherited from enterRealtime(), the nice fallback included
+*/
+void leaveRealtime(RealtimeConfig* rt)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int cpu = 0; cpu < cpus; cpu++)
+    {
+        if (cpu != rt->clockCpu && cpu != rt->schedulerCpu)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    if (CPU_COUNT(&set) > 0)
+    {
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+    munlockall();
+    setpriority(PRIO_PROCESS, 0, 0);
+}
 
 
 ///==============================
@@ -33,19 +270,26 @@ int * shmaddr;                 //
 }
 
 
+/* When the current tick happened, CLOCK_MONOTONIC nanoseconds */
+long long getClkTimestamp()
+{
+    return ((ClockShared*)shmaddr)->tickNs;
+}
+
+
 /*
  * All process call this function at the beginning to establish communication between them and the clock module.
  * Again, remember that the clock is only emulation!
 */
  void initClk()
 {
-    int shmid = shmget(SHKEY, 4, 0444);
+    int shmid = shmget(runKey(SHKEY), 4, 0444);
     while ((int)shmid == -1)
     {
         //Make sure that the clock exists
         printf("Wait! The clock not initialized yet!\n");
         sleep(1);
-        shmid = shmget(SHKEY, 4, 0444);
+        shmid = shmget(runKey(SHKEY), 4, 0444);
     }
     shmaddr = (int *) shmat(shmid, (void *)0, 0);
 }
@@ -57,6 +301,8 @@ int * shmaddr;                 //
  * Again, Remember that the clock is only emulation!
  * Input: terminateAll: a flag to indicate whether that this is the end of simulation.
  *                      It terminates the whole system and releases resources.
+ *                      Only this simulation's process group is signalled, the
+ *                      generator of a named run gets a group of its own.
 */
 
  void destroyClk(bool terminateAll)
@@ -22,9 +22,18 @@ int main(int argc, char * argv[])
 {
     printf("Clock starting\n");
     signal(SIGINT, cleanup);
-    int clk = 0;
-    //Create shared memory for one integer variable 4 bytes
-    shmid = shmget(SHKEY, 4, IPC_CREAT | 0644);
+    // A restored simulation continues from its checkpointed time
+    int clk = (argc > 1) ? atoi(argv[1]) : 0;
+
+    RealtimeConfig rt;
+    if (realtimeConfig(&rt))
+    {
+        // Above the scheduler, a late tick delays everything
+        enterRealtime("Clock", rt.clockCpu, rt.priority + 1);
+    }
+
+    //Create shared memory for the clock and its tick statistics
+    shmid = shmget(runKey(SHKEY), sizeof(ClockShared), IPC_CREAT | 0644);
     if ((long)shmid == -1)
     {
         perror("Error in creating shm!");
@@ -36,10 +45,25 @@ int main(int argc, char * argv[])
         perror("Error in attaching the shm in clock!");
         exit(-1);
     }
-    *shmaddr = clk; /* initialize shared memory */
+    ClockShared* shared = (ClockShared*)shmaddr;
+    memset(shared, 0, sizeof(ClockShared));
+    shared->tickNs = monotonicNs();
+    shared->clock = clk; /* initialize shared memory */
+
+    // Ticks are due at absolute times, so a late wakeup doesn't push back the ones after it
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
     while (1)
     {
-        sleep(1);
-        (*shmaddr)++;
+        deadline.tv_sec++;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        {
+        }
+
+        long long now = monotonicNs();
+        histogramAdd(&shared->jitter, now - (deadline.tv_sec * 1000000000LL + deadline.tv_nsec));
+        shared->tickNs = now;
+        __sync_synchronize();
+        shared->clock++;
     }
 }
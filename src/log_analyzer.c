@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Metrics and event filtering straight from a scheduler.log, without rerunning
+ * the simulation. The log is mmap'd and cut into line aligned chunks, one per
+ * thread. Every finished line carries the process's arrival, runtime, waiting
+ * and finish time, so the threads never need to know what happened in another
+ * chunk. Their results are concatenated in chunk order, which keeps log order.
+ */
+
+#define MAX_THREADS 64
+
+// A finished process
+typedef struct {
+    int id;
+    int arrival;
+    int runtime;
+    int finish;
+    int waiting;
+    long long seq;          // position in the log, set once the chunks are joined
+} FinishRecord;
+
+typedef struct {
+    const char* begin;
+    const char* end;
+    FinishRecord* records;
+    long long count;
+    long long capacity;
+    long long lines;
+    long long matched;      // events passing the filters
+    FILE* events;           // matching lines, when they are printed
+} Chunk;
+
+// Options
+const char* inputFile = "scheduler.log";
+const char* processFile = NULL;     // per process table
+bool printEvents = false;
+int threadCount = 0;
+int fromId = INT_MIN, toId = INT_MAX;
+int fromTime = INT_MIN, toTime = INT_MAX;
+
+Chunk chunks[MAX_THREADS];
+
+// Function declarations
+bool parseArguments(int argc, char * argv[]);
+bool parseRange(const char* text, int* from, int* to);
+void* analyzeChunk(void* arg);
+bool parseEvent(const char* line, const char* end, int* time, int* id, bool* finished,
+                FinishRecord* record);
+const char* parseNumber(const char* p, const char* end, int* value);
+const char* expectText(const char* p, const char* end, const char* text);
+void addRecord(Chunk* chunk, FinishRecord* record);
+int compareDoubles(const void* a, const void* b);
+int compareById(const void* a, const void* b);
+int compareBySeq(const void* a, const void* b);
+long long dropRepeats(FinishRecord* all, long long count);
+void writeSummary(FILE* report, FinishRecord* all, long long count, int lastTime);
+void writePercentiles(FILE* report, const char* name, double* values, long long count);
+
+
+int main(int argc, char * argv[])
+{
+    if (!parseArguments(argc, argv)) {
+        return -1;
+    }
+
+    int fd = open(inputFile, O_RDONLY);
+    if (fd == -1) {
+        perror("Error opening log file");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("Error reading log file size");
+        return -1;
+    }
+    if (st.st_size == 0) {
+        printf("%s is empty\n", inputFile);
+        return -1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    const char* data = (const char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mapping log file");
+        return -1;
+    }
+    madvise((void*)data, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    // Cut the file into equal chunks, each one ending after a newline
+    const char* fileEnd = data + st.st_size;
+    const char* p = data;
+    for (int i = 0; i < threadCount; i++) {
+        chunks[i].begin = p;
+        const char* cut = data + st.st_size * (i + 1) / threadCount;
+        if (cut < p) {
+            cut = p;
+        }
+        if (i == threadCount - 1) {
+            cut = fileEnd;
+        } else {
+            const char* newline = (const char*)memchr(cut, '\n', fileEnd - cut);
+            cut = (newline != NULL) ? newline + 1 : fileEnd;
+        }
+        chunks[i].end = cut;
+        p = cut;
+    }
+
+    pthread_t threads[MAX_THREADS];
+    for (int i = 0; i < threadCount; i++) {
+        if (printEvents) {
+            chunks[i].events = tmpfile();
+            if (chunks[i].events == NULL) {
+                perror("Error creating event buffer");
+                return -1;
+            }
+        }
+        pthread_create(&threads[i], NULL, analyzeChunk, &chunks[i]);
+    }
+
+    long long total = 0, lines = 0, matched = 0;
+    for (int i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+        total += chunks[i].count;
+        lines += chunks[i].lines;
+        matched += chunks[i].matched;
+    }
+
+    // Matching events in log order
+    if (printEvents) {
+        char buffer[1 << 16];
+        for (int i = 0; i < threadCount; i++) {
+            rewind(chunks[i].events);
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), chunks[i].events)) > 0) {
+                fwrite(buffer, 1, n, stdout);
+            }
+            fclose(chunks[i].events);
+        }
+    }
+
+    FinishRecord* all = (FinishRecord*)malloc(sizeof(FinishRecord) * (total > 0 ? total : 1));
+    long long offset = 0;
+    int lastTime = 0;
+    for (int i = 0; i < threadCount; i++) {
+        memcpy(all + offset, chunks[i].records, sizeof(FinishRecord) * chunks[i].count);
+        offset += chunks[i].count;
+        free(chunks[i].records);
+    }
+    for (long long i = 0; i < total; i++) {
+        all[i].seq = i;
+    }
+    total = dropRepeats(all, total);
+    for (long long i = 0; i < total; i++) {
+        if (all[i].finish > lastTime) {
+            lastTime = all[i].finish;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (processFile != NULL) {
+        FILE* file = fopen(processFile, "w");
+        if (file == NULL) {
+            perror("Error opening process table");
+        } else {
+            fprintf(file, "#id arrival runtime finish TA WTA waiting\n");
+            for (long long i = 0; i < total; i++) {
+                FinishRecord* r = &all[i];
+                int ta = r->finish - r->arrival;
+                fprintf(file, "%d\t%d\t%d\t%d\t%d\t%.2f\t%d\n", r->id, r->arrival, r->runtime,
+                        r->finish, ta, (r->runtime > 0) ? (double)ta / r->runtime : 0, r->waiting);
+            }
+            fclose(file);
+        }
+    }
+
+    // The summary goes to stderr when stdout carries the events
+    FILE* report = printEvents ? stderr : stdout;
+    fprintf(report, "Parsed %lld lines (%.1f MB) with %d threads in %.3f s, %.0f MB/s\n",
+            lines, st.st_size / 1e6, threadCount, seconds, (seconds > 0) ? st.st_size / 1e6 / seconds : 0);
+    fprintf(report, "Events matching filters = %lld\n", matched);
+    writeSummary(report, all, total, lastTime);
+
+    free(all);
+    munmap((void*)data, st.st_size);
+    return 0;
+}
+
+bool parseArguments(int argc, char * argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--process") == 0 && i + 1 < argc) {
+            if (!parseRange(argv[++i], &fromId, &toId)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            if (!parseRange(argv[++i], &fromTime, &toTime)) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--events") == 0) {
+            printEvents = true;
+        } else if (strcmp(argv[i], "--per-process") == 0 && i + 1 < argc) {
+            processFile = argv[++i];
+        } else if (argv[i][0] != '-') {
+            inputFile = argv[i];
+        } else {
+            printf("Usage: %s [scheduler.log] [--threads n] [--process id[-id]] [--time t[-t]]\n"
+                   "          [--events] [--per-process file]\n", argv[0]);
+            return false;
+        }
+    }
+
+    if (threadCount <= 0) {
+        threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+    if (threadCount > MAX_THREADS) {
+        threadCount = MAX_THREADS;
+    }
+    return true;
+}
+
+// "a" or "a-b", either end of "a-b" may be left out
+bool parseRange(const char* text, int* from, int* to) {
+    const char* dash = strchr(text, '-');
+    if (dash == NULL) {
+        *from = *to = atoi(text);
+        return true;
+    }
+    if (dash != text) {
+        *from = atoi(text);
+    }
+    if (dash[1] != '\0') {
+        *to = atoi(dash + 1);
+    }
+    if (*from > *to) {
+        printf("Error: empty range '%s'!\n", text);
+        return false;
+    }
+    return true;
+}
+
+void* analyzeChunk(void* arg) {
+    Chunk* chunk = (Chunk*)arg;
+    const char* p = chunk->begin;
+
+    while (p < chunk->end) {
+        const char* newline = (const char*)memchr(p, '\n', chunk->end - p);
+        const char* lineEnd = (newline != NULL) ? newline : chunk->end;
+        chunk->lines++;
+
+        int time, id;
+        bool finished;
+        FinishRecord record;
+        if (parseEvent(p, lineEnd, &time, &id, &finished, &record) &&
+            id >= fromId && id <= toId && time >= fromTime && time <= toTime) {
+            chunk->matched++;
+            if (finished) {
+                addRecord(chunk, &record);
+            }
+            if (chunk->events != NULL) {
+                fwrite(p, 1, lineEnd - p, chunk->events);
+                fputc('\n', chunk->events);
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+    return NULL;
+}
+
+/*
+ * "At time t process id state arr a total r remain x wait w[ TA n WTA f]"
+ * Hand rolled instead of sscanf, which would dominate the run time.
+ */
+bool parseEvent(const char* line, const char* end, int* time, int* id, bool* finished,
+                FinishRecord* record) {
+    const char* p = expectText(line, end, "At time ");
+    p = parseNumber(p, end, time);
+    p = expectText(p, end, " process ");
+    p = parseNumber(p, end, id);
+    p = expectText(p, end, " ");
+    if (p == NULL) {
+        return false;
+    }
+
+    const char* state = p;
+    while (p < end && *p != ' ') {
+        p++;
+    }
+    *finished = (p - state == 8 && memcmp(state, "finished", 8) == 0);
+    if (!*finished) {
+        return true;
+    }
+
+    int remaining;
+    p = expectText(p, end, " arr ");
+    p = parseNumber(p, end, &record->arrival);
+    p = expectText(p, end, " total ");
+    p = parseNumber(p, end, &record->runtime);
+    p = expectText(p, end, " remain ");
+    p = parseNumber(p, end, &remaining);
+    p = expectText(p, end, " wait ");
+    p = parseNumber(p, end, &record->waiting);
+    if (p == NULL) {
+        return false;
+    }
+    record->id = *id;
+    record->finish = *time;
+    return true;
+}
+
+// Both helpers pass NULL through, so a chain of them fails at the first mismatch
+const char* parseNumber(const char* p, const char* end, int* value) {
+    if (p == NULL || p >= end) {
+        return NULL;
+    }
+
+    bool negative = (*p == '-');
+    if (negative) {
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    *value = (int)(negative ? -v : v);
+    return p;
+}
+
+const char* expectText(const char* p, const char* end, const char* text) {
+    if (p == NULL) {
+        return NULL;
+    }
+    size_t len = strlen(text);
+    if ((size_t)(end - p) < len || memcmp(p, text, len) != 0) {
+        return NULL;
+    }
+    return p + len;
+}
+
+void addRecord(Chunk* chunk, FinishRecord* record) {
+    if (chunk->count == chunk->capacity) {
+        chunk->capacity = (chunk->capacity == 0) ? 4096 : chunk->capacity * 2;
+        chunk->records = (FinishRecord*)realloc(chunk->records, sizeof(FinishRecord) * chunk->capacity);
+        if (chunk->records == NULL) {
+            perror("Error growing process records");
+            exit(-1);
+        }
+    }
+    chunk->records[chunk->count++] = *record;
+}
+
+/*
+ * A restored run appends the events from its checkpoint on to the log again,
+ * so a process can have finished twice. The last time counts, like the
+ * restored scheduler's own metrics. The log order is kept.
+ */
+long long dropRepeats(FinishRecord* all, long long count) {
+    qsort(all, count, sizeof(FinishRecord), compareById);
+    long long kept = 0;
+    for (long long i = 0; i < count; i++) {
+        if (i + 1 < count && all[i + 1].id == all[i].id) {
+            continue;
+        }
+        all[kept++] = all[i];
+    }
+    qsort(all, kept, sizeof(FinishRecord), compareBySeq);
+    return kept;
+}
+
+int compareById(const void* a, const void* b) {
+    const FinishRecord* x = (const FinishRecord*)a;
+    const FinishRecord* y = (const FinishRecord*)b;
+    if (x->id != y->id) {
+        return (x->id > y->id) - (x->id < y->id);
+    }
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+int compareBySeq(const void* a, const void* b) {
+    const FinishRecord* x = (const FinishRecord*)a;
+    const FinishRecord* y = (const FinishRecord*)b;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Same metrics as the scheduler's scheduler.perf, as far as the log can tell
+void writeSummary(FILE* report, FinishRecord* all, long long count, int lastTime) {
+    fprintf(report, "Finished processes = %lld\n", count);
+    if (count == 0) {
+        return;
+    }
+
+    double totalWTA = 0, totalWTASquared = 0;
+    long long totalWaiting = 0, totalRuntime = 0;
+    double* ta = (double*)malloc(sizeof(double) * count);
+    double* wta = (double*)malloc(sizeof(double) * count);
+    double* waiting = (double*)malloc(sizeof(double) * count);
+
+    for (long long i = 0; i < count; i++) {
+        FinishRecord* r = &all[i];
+        ta[i] = r->finish - r->arrival;
+        wta[i] = (r->runtime > 0) ? ta[i] / r->runtime : 0;
+        waiting[i] = r->waiting;
+        totalWTA += wta[i];
+        totalWTASquared += wta[i] * wta[i];
+        totalWaiting += r->waiting;
+        totalRuntime += r->runtime;
+    }
+
+    double avgWTA = totalWTA / count;
+    double variance = totalWTASquared / count - avgWTA * avgWTA;
+
+    // Utilization and throughput only make sense over the whole run. The log has
+    // no busy ticks, so this is finished CPU time over the last finish, which
+    // can differ slightly from scheduler.perf's busy ticks over its end time
+    if (fromId == INT_MIN && toId == INT_MAX && fromTime == INT_MIN && toTime == INT_MAX && lastTime > 0) {
+        fprintf(report, "CPU utilization (runtime / last finish) = %.2f%%\n",
+                (double)totalRuntime / lastTime * 100);
+    }
+    fprintf(report, "Avg WTA = %.2f\n", avgWTA);
+    fprintf(report, "Avg Waiting = %.2f\n", (double)totalWaiting / count);
+    fprintf(report, "Std WTA = %.2f\n", sqrt(variance > 0 ? variance : 0));
+    if (fromTime == INT_MIN && toTime == INT_MAX && lastTime > 0) {
+        fprintf(report, "Throughput = %.4f processes per unit time\n", (double)count / lastTime);
+    }
+
+    writePercentiles(report, "TA", ta, count);
+    writePercentiles(report, "WTA", wta, count);
+    writePercentiles(report, "Waiting", waiting, count);
+
+    free(ta);
+    free(wta);
+    free(waiting);
+}
+
+void writePercentiles(FILE* report, const char* name, double* values, long long count) {
+    qsort(values, count, sizeof(double), compareDoubles);
+    fprintf(report, "%s p50 = %.2f, p90 = %.2f, p99 = %.2f, max = %.2f\n", name,
+           values[(count - 1) * 50 / 100], values[(count - 1) * 90 / 100],
+           values[(count - 1) * 99 / 100], values[count - 1]);
+}
@@ -6,6 +6,13 @@
  */
 
 int remainingtime;
+volatile int lastTime;
+
+/* Time spent stopped by the scheduler doesn't count as execution */
+void handleContinue(int signum)
+{
+    lastTime = getClk();
+}
 
 int main(int argc, char * argv[])
 {
@@ -28,7 +35,8 @@ int main(int argc, char * argv[])
     
     // Simulate CPU-bound execution
     // The process runs until remaining time reaches 0
-    int lastTime = getClk();
+    lastTime = getClk();
+    signal(SIGCONT, handleContinue);
     
     while (remainingtime > 0)
     {
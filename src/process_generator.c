@@ -1,7 +1,16 @@
 #include "../include/headers.h"
+#include "../include/checkpoint.h"
 #include <string.h>
+#include <math.h>
+#include <errno.h>
 
-#define MAX_PROCESSES 100
+// External merge sort of the workload by arrival time
+#define DEFAULT_SORT_MEMORY_MB 64
+#define MERGE_FANIN 64              // runs merged at once
+#define RUN_BUFFER_RECORDS 1024     // records buffered per run while merging
+
+// Trace column mapping
+#define TRACE_MAX_FIELDS 64
 
 // Process structure to hold process data
 typedef struct {
@@ -9,6 +18,9 @@ typedef struct {
     int arrivalTime;
     int runtime;
     int priority;
+    int memsize;
+    int burstCount;             // 0 for a pure CPU process
+    int bursts[MAX_BURSTS];     // CPU, IO, CPU, ... , CPU
 } Process;
 
 // Message structure for IPC with scheduler
@@ -17,73 +29,253 @@ typedef struct {
     Process process;
 } Message;
 
+// A process waiting to be sorted, seq keeps equal arrivals in input order
+typedef struct {
+    long long key;
+    long long seq;
+    Process process;
+} SortRecord;
+
+// A sorted run being merged
+typedef struct {
+    FILE* file;
+    SortRecord* buffer;
+    int pos;
+    int len;
+} SortRun;
+
+// Open-loop workload: a random variable a process attribute is drawn from
+typedef enum {
+    DIST_CONST,         // a
+    DIST_UNIFORM,       // a to b
+    DIST_EXP,           // mean a
+    DIST_PARETO         // shape a, minimum b, heavy tailed
+} DistributionKind;
+
+typedef struct {
+    DistributionKind kind;
+    double a;
+    double b;
+} Distribution;
+
+// Columns of an external trace, index -1 if not mapped
+typedef enum {
+    COL_SUBMIT,
+    COL_DURATION,
+    COL_PRIORITY,
+    COL_MEMSIZE,
+    COL_ID,
+    COL_COUNT
+} TraceColumn;
+
 void clearResources(int);
-int readProcesses(const char* filename, Process processes[]);
+long long readProcesses(const char* filename);
+long long readTrace(const char* filename);
+bool parseColumnMap(const char* spec);
+int splitFields(char* line, char* fields[], int max);
+void sorterInit(size_t memoryBytes);
+void sorterAdd(long long key, Process* process);
+void sorterSpill();
+bool sorterFinish();
+bool sorterNext(Process* process);
+FILE* mergeRuns(FILE** files, int count);
+void mergeOpen(FILE** files, int count);
+bool mergePop(SortRecord* record);
+void mergeClose();
+int compareRecords(const void* a, const void* b);
+bool refillRun(SortRun* run);
+bool runLess(int a, int b);
+void siftDown(int i);
+bool nextProcess(Process* process);
+bool synthesizeProcess(Process* process);
+bool parseDistribution(const char* spec, Distribution* dist);
+double sampleDistribution(Distribution* dist);
+bool parseBursts(char* text, Process* process);
 void createSchedulerAndClock(int algorithm, int quantum);
-void sendProcessesToScheduler(Process processes[], int count, int msgqid);
+void parseArguments(int argc, char * argv[]);
+void setSchedulerOption(const char* name, const char* value);
+bool prepareInstance();
+void enterOutputDir();
+void enterOwnGroup();
+void setupRealtime();
+bool chooseAlgorithm(int* algorithm, int* quantum);
+bool loadCheckpoint(int* algorithm, int* quantum);
+void saveArguments(int argc, char * argv[], int algorithm, int quantum);
+void sendProcessesToScheduler(int msgqid);
 
 // Global variables for cleanup
 int msgqid = -1;
 pid_t schedulerPid = -1;
 pid_t clockPid = -1;
+pid_t terminalGroup = -1;   // foreground group of the terminal before a named run took it
+
+// Command line options forwarded to the scheduler
+#define MAX_SCHEDULER_OPTIONS 32
+char* schedulerOptions[MAX_SCHEDULER_OPTIONS];
+int schedulerOptionCount = 0;
+bool checkpointing = false;
+bool restoreMode = false;
+
+// Simulation instance, see runKey() in headers.h
+char outputDir[256] = "";
+char checkpointPath[PATH_MAX] = CHECKPOINT_FILE;
+
+// Open-loop mode synthesizes arrivals instead of reading them
+bool openLoop = false;
+double arrivalRate = 1.0;               // mean arrivals per tick
+int openLoopDuration = 0;               // ticks, 0 runs until interrupted
+Distribution interarrival = { DIST_EXP, 1.0, 0 };
+Distribution runtimeDist = { DIST_EXP, 10.0, 0 };
+Distribution priorityDist = { DIST_UNIFORM, 0, 10 };
+Distribution memsizeDist = { DIST_UNIFORM, 1, 256 };
+long openLoopSeed = 1;
+double openLoopClock = 0;               // arrival time of the last synthesized process
+int openLoopNextId = 1;
+bool windowGiven = false;
+
+// Adaptive Round Robin bounds, forwarded to the scheduler, kept here to check them
+int quantumMin = 1;
+int quantumMax = 20;
+int quantumPercentile = 80;
+
+// Real-time mode, handed to the clock and scheduler through REALTIME_ENV
+bool realtime = false;
+int realtimeClockCpu = -2;      // -2 picks a default, -1 doesn't pin
+int realtimeSchedulerCpu = -2;
+int realtimePriority = 50;
+
+// Input options
+char traceFile[256] = "";
+char columnSpec[COL_COUNT][64] = { "0", "1", "", "", "" };
+double timeScale = 1.0;                 // ticks per trace time unit
+size_t sortMemory = (size_t)DEFAULT_SORT_MEMORY_MB << 20;
+
+// Sorter state
+SortRecord* sortBuffer = NULL;
+size_t sortBufferLen = 0;
+size_t sortBufferCap = 0;
+size_t sortBufferPos = 0;               // read position once sorted in memory
+FILE** runFiles = NULL;
+int* runLevels = NULL;                  // merge passes behind each run, never increasing along runFiles
+int runCount = 0;
+int runCapacity = 0;
+int runsSpilled = 0;
+long long sortSeq = 0;
+long long lastKey = 0;
+long long outOfOrder = 0;
+bool inMemory = false;
+
+// Merge state, a min-heap of run indices
+SortRun* mergeRunsState = NULL;
+int* mergeHeap = NULL;
+int mergeHeapSize = 0;
+int mergeRunCount = 0;
+
+// Trace arrivals are rebased so the first job arrives at time 1
+bool rebaseArrivals = false;
+long long firstKey = 0;
+bool haveFirstKey = false;
+
+// Checkpoint/restore
+Checkpoint* checkpoint = NULL;
+int arrivalCursor = 0;      // next process to send
+int startClock = 0;
 
 int main(int argc, char * argv[])
 {
     signal(SIGINT, clearResources);
+    parseArguments(argc, argv);
+    if (!prepareInstance()) {
+        return -1;
+    }
     
-    Process processes[MAX_PROCESSES];
-    int processCount = 0;
+    long long processCount = 0;
     int algorithm;
     int quantum = 0;
     
-    // 1. Read the input files
-    printf("Reading processes from file...\n");
-    processCount = readProcesses("processes.txt", processes);
-    
-    if (processCount == 0) {
-        printf("No processes found or error reading file!\n");
+    // A restore takes the original options and the scheduler's position from the checkpoint
+    if (restoreMode && !loadCheckpoint(&algorithm, &quantum)) {
         return -1;
     }
     
-    printf("Successfully read %d processes\n", processCount);
-    
-    // 2. Ask the user for the chosen scheduling algorithm and its parameters
-    printf("\nChoose the scheduling algorithm:\n");
-    printf("1. Preemptive Highest Priority First (HPF)\n");
-    printf("2. Shortest Job Next (SJN)\n");
-    printf("3. Round Robin (RR)\n");
-    printf("Enter choice (1-3): ");
-    scanf("%d", &algorithm);
+    // 1. Read the input files, sorting them by arrival with bounded memory
+    sorterInit(sortMemory);
+    if (openLoop) {
+        printf("Open-loop workload: %.3f arrivals per tick for %s\n", arrivalRate,
+               (openLoopDuration > 0) ? "a fixed duration" : "ever");
+        srand48(openLoopSeed);
+        processCount = -1;
+    } else if (traceFile[0] != '\0') {
+        printf("Importing trace %s...\n", traceFile);
+        processCount = readTrace(traceFile);
+        rebaseArrivals = true;
+    } else {
+        printf("Reading processes from file...\n");
+        processCount = readProcesses("processes.txt");
+    }
     
-    if (algorithm < 1 || algorithm > 3) {
-        printf("Invalid algorithm choice!\n");
+    if (processCount == 0 || (!openLoop && !sorterFinish())) {
+        printf("No processes found or error reading file!\n");
         return -1;
     }
     
-    // If Round Robin, ask for quantum
-    if (algorithm == 3) {
-        printf("Enter time quantum for Round Robin: ");
-        scanf("%d", &quantum);
-        if (quantum <= 0) {
-            printf("Invalid quantum value!\n");
+    if (!openLoop) {
+        printf("Successfully read %lld processes\n", processCount);
+    }
+    if (outOfOrder > 0) {
+        printf("Input wasn't sorted by arrival (%lld out of order), sorted it in %d run(s)\n",
+               outOfOrder, inMemory ? 1 : runsSpilled);
+    }
+    
+    // 2. Ask the user for the chosen scheduling algorithm and its parameters
+    if (!restoreMode) {
+        if (!chooseAlgorithm(&algorithm, &quantum)) {
             return -1;
         }
+        
+        if (checkpointing) {
+            checkpoint = openCheckpoint(checkpointPath, true);
+            if (checkpoint == NULL) {
+                return -1;
+            }
+            saveArguments(argc, argv, algorithm, quantum);
+        }
+    }
+    
+    // A named run gets its own process group so destroyClk() can't reach
+    // into simulations running next to it
+    if (getenv(RUN_ID_ENV) != NULL) {
+        enterOwnGroup();
     }
     
     // 3. Create message queue for IPC
-    key_t msgkey = ftok(".", 'M');
+    key_t msgkey = (getenv(RUN_ID_ENV) != NULL) ? runKey(SHKEY + 1) : ftok(".", MSGKEY_PROJ);
     msgqid = msgget(msgkey, IPC_CREAT | 0644);
+    if (msgqid != -1 && restoreMode) {
+        // Drop whatever the crashed run left in flight, it gets resent from the cursor
+        msgctl(msgqid, IPC_RMID, NULL);
+        msgqid = msgget(msgkey, IPC_CREAT | 0644);
+    }
     if (msgqid == -1) {
         perror("Error creating message queue");
         return -1;
     }
     printf("Message queue created with ID: %d\n", msgqid);
     
+    // Clock and scheduler read the real-time settings from the environment
+    if (realtime) {
+        setupRealtime();
+    }
+    
     // 4. Create the clock process
     clockPid = fork();
     if (clockPid == 0) {
         // Child process - run clock
-        execl("./clk.out", "clk.out", NULL);
+        char clockStr[16], clockBinary[PATH_MAX];
+        sprintf(clockStr, "%d", startClock);
+        binaryPath(clockBinary, sizeof(clockBinary), "clk.out");
+        enterOutputDir();
+        execl(clockBinary, "clk.out", clockStr, NULL);
         perror("Error executing clock");
         exit(-1);
     } else if (clockPid == -1) {
@@ -107,7 +299,24 @@ int main(int argc, char * argv[])
         sprintf(quantumStr, "%d", quantum);
         sprintf(msgqStr, "%d", msgqid);
         
-        execl("./scheduler.out", "scheduler.out", algoStr, quantumStr, msgqStr, NULL);
+        char* schedArgs[MAX_SCHEDULER_OPTIONS + 6];
+        int n = 0;
+        schedArgs[n++] = "scheduler.out";
+        schedArgs[n++] = algoStr;
+        schedArgs[n++] = quantumStr;
+        schedArgs[n++] = msgqStr;
+        for (int i = 0; i < schedulerOptionCount; i++) {
+            schedArgs[n++] = schedulerOptions[i];
+        }
+        if (restoreMode) {
+            schedArgs[n++] = "--restore";
+        }
+        schedArgs[n] = NULL;
+        
+        char schedulerBinary[PATH_MAX];
+        binaryPath(schedulerBinary, sizeof(schedulerBinary), "scheduler.out");
+        enterOutputDir();
+        execv(schedulerBinary, schedArgs);
         perror("Error executing scheduler");
         exit(-1);
     } else if (schedulerPid == -1) {
@@ -123,7 +332,7 @@ int main(int argc, char * argv[])
     
     // 7. Main loop - send processes to scheduler at appropriate arrival times
     printf("\nStarting process generation...\n");
-    sendProcessesToScheduler(processes, processCount, msgqid);
+    sendProcessesToScheduler(msgqid);
     
     // 8. Wait for scheduler to finish
     printf("Waiting for scheduler to complete...\n");
@@ -136,8 +345,316 @@ int main(int argc, char * argv[])
     return 0;
 }
 
+// Parse optional command line flags
+void parseArguments(int argc, char * argv[]) {
+    // Options that only concern the scheduler are passed on untouched
+    static const char* forwarded[] = { "--memory", "--checkpoint", "--switch-cost", "--quantum-min",
+                                         "--quantum-max", "--quantum-percentile", "--window", "--aging", NULL };
+    
+    for (int i = 1; i < argc; i++) {
+        int f = 0;
+        while (forwarded[f] != NULL && strcmp(argv[i], forwarded[f]) != 0) {
+            f++;
+        }
+        
+        if (forwarded[f] != NULL && i + 1 < argc) {
+            if (strcmp(argv[i], "--checkpoint") == 0) {
+                checkpointing = true;
+            }
+            if (strcmp(argv[i], "--window") == 0) {
+                windowGiven = true;
+            }
+            if (strcmp(argv[i], "--quantum-min") == 0) {
+                quantumMin = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "--quantum-max") == 0) {
+                quantumMax = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "--quantum-percentile") == 0) {
+                quantumPercentile = atoi(argv[i + 1]);
+            }
+            setSchedulerOption(argv[i], argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--restore") == 0) {
+            restoreMode = true;
+        } else if (strcmp(argv[i], "--run-id") == 0 && i + 1 < argc) {
+            setenv(RUN_ID_ENV, argv[++i], 1);
+        } else if (strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc) {
+            snprintf(outputDir, sizeof(outputDir), "%s", argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            snprintf(traceFile, sizeof(traceFile), "%s", argv[++i]);
+        } else if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc) {
+            if (!parseColumnMap(argv[++i])) {
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--time-scale") == 0 && i + 1 < argc) {
+            timeScale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sort-memory") == 0 && i + 1 < argc) {
+            int megabytes = atoi(argv[++i]);
+            if (megabytes < 0) {
+                printf("--sort-memory must not be negative\n");
+                exit(-1);
+            }
+            sortMemory = (size_t)megabytes << 20;
+        } else if (strcmp(argv[i], "--open-loop") == 0 && i + 1 < argc) {
+            openLoop = true;
+            arrivalRate = atof(argv[++i]);
+            if (arrivalRate <= 0) {
+                printf("--open-loop needs a positive arrival rate\n");
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--arrivals") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "poisson") == 0) {
+                interarrival.kind = DIST_EXP;
+            } else if (strcmp(argv[i], "const") == 0) {
+                interarrival.kind = DIST_CONST;
+            } else if (strcmp(argv[i], "uniform") == 0) {
+                interarrival.kind = DIST_UNIFORM;
+            } else {
+                printf("--arrivals takes poisson, const or uniform\n");
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            openLoopDuration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--runtime") == 0 && i + 1 < argc) {
+            if (!parseDistribution(argv[++i], &runtimeDist)) {
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+            if (!parseDistribution(argv[++i], &priorityDist)) {
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--memsize") == 0 && i + 1 < argc) {
+            if (!parseDistribution(argv[++i], &memsizeDist)) {
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            openLoopSeed = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if (strcmp(argv[i], "--rt-cpus") == 0 && i + 1 < argc) {
+            realtime = true;
+            if (sscanf(argv[++i], "%d,%d", &realtimeClockCpu, &realtimeSchedulerCpu) != 2) {
+                printf("--rt-cpus takes clockCpu,schedulerCpu\n");
+                exit(-1);
+            }
+        } else if (strcmp(argv[i], "--rt-priority") == 0 && i + 1 < argc) {
+            realtime = true;
+            realtimePriority = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [--memory bytes] [--checkpoint ticks] [--restore] [--switch-cost ticks]\n"
+                   "          [--aging ticks_per_priority_level]\n"
+                   "          [--quantum-min q] [--quantum-max q] [--quantum-percentile p]\n"
+                   "          [--run-id name] [--output-dir dir]\n"
+                   "          [--trace file.csv] [--columns submit=0,duration=1,priority=2,memsize=3,id=4]\n"
+                   "          [--time-scale ticks_per_unit] [--sort-memory MB]\n"
+                   "          [--realtime] [--rt-cpus clock,scheduler] [--rt-priority p]\n"
+                   "          [--open-loop rate] [--arrivals poisson|const|uniform] [--duration ticks]\n"
+                   "          [--runtime dist] [--priority dist] [--memsize dist] [--seed n] [--window ticks]\n",
+                   argv[0]);
+            exit(-1);
+        }
+    }
+    
+    // Checked here as well, a bad value would otherwise only show once the scheduler starts
+    if (quantumMin < 1 || quantumMin > quantumMax || quantumPercentile < 1 || quantumPercentile > 100) {
+        printf("Need 1 <= --quantum-min <= --quantum-max and 1 <= --quantum-percentile <= 100\n");
+        exit(-1);
+    }
+    
+    // Interarrival times follow from the rate, all three kinds have mean 1 / rate
+    interarrival.a = (interarrival.kind == DIST_UNIFORM) ? 0 : 1 / arrivalRate;
+    interarrival.b = 2 / arrivalRate;
+    
+    // Open-loop runs report as they go
+    if (openLoop && !windowGiven) {
+        setSchedulerOption("--window", "100");
+    }
+}
+
+// Set an option for the scheduler, a later value replaces an earlier one so
+// a restore can parse the saved command line on top of the current one
+void setSchedulerOption(const char* name, const char* value) {
+    for (int i = 0; i < schedulerOptionCount; i += 2) {
+        if (strcmp(schedulerOptions[i], name) == 0) {
+            schedulerOptions[i + 1] = (char*)value;
+            return;
+        }
+    }
+    
+    if (schedulerOptionCount + 2 > MAX_SCHEDULER_OPTIONS) {
+        printf("Too many scheduler options!\n");
+        exit(-1);
+    }
+    schedulerOptions[schedulerOptionCount++] = (char*)name;
+    schedulerOptions[schedulerOptionCount++] = (char*)value;
+}
+
+// The two highest numbered CPUs go to the clock and the scheduler, the
+// simulated processes get the rest
+void setupRealtime() {
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (realtimeClockCpu == -2) {
+        realtimeClockCpu = (cpus >= 2) ? cpus - 1 : -1;
+    }
+    if (realtimeSchedulerCpu == -2) {
+        realtimeSchedulerCpu = (cpus >= 3) ? cpus - 2 : realtimeClockCpu;
+    }
+
+    char spec[64];
+    snprintf(spec, sizeof(spec), "%d,%d,%d", realtimeClockCpu, realtimeSchedulerCpu, realtimePriority);
+    setenv(REALTIME_ENV, spec, 1);
+    printf("Real-time mode: clock on CPU %d, scheduler on CPU %d, priority %d\n",
+           realtimeClockCpu, realtimeSchedulerCpu, realtimePriority);
+}
+
+// Set up the output directory of this instance and make sure no other live
+// simulation uses the same run ID
+bool prepareInstance() {
+    const char* runId = getenv(RUN_ID_ENV);
+    
+    if (runId != NULL && runId[0] != '\0') {
+        if (outputDir[0] == '\0') {
+            snprintf(outputDir, sizeof(outputDir), "run-%s", runId);
+        }
+        
+        // A clock segment somebody is still attached to means the ID is taken,
+        // an unattached one was left behind by a crashed run, so was its queue
+        int shmid = shmget(runKey(SHKEY), 4, 0);
+        struct shmid_ds info;
+        if (shmid != -1 && shmctl(shmid, IPC_STAT, &info) != -1) {
+            if (info.shm_nattch > 0) {
+                printf("Run ID '%s' is already in use by another simulation!\n", runId);
+                return false;
+            }
+            shmctl(shmid, IPC_RMID, NULL);
+            int staleQueue = msgget(runKey(SHKEY + 1), 0);
+            if (staleQueue != -1) {
+                msgctl(staleQueue, IPC_RMID, NULL);
+            }
+        }
+    }
+    
+    if (outputDir[0] != '\0') {
+        if (mkdir(outputDir, 0755) == -1 && errno != EEXIST) {
+            perror("Error creating output directory");
+            return false;
+        }
+        snprintf(checkpointPath, sizeof(checkpointPath), "%s/%s", outputDir, CHECKPOINT_FILE);
+        printf("Writing output to %s\n", outputDir);
+    }
+    return true;
+}
+
+// Move to a new process group. A run in the terminal's foreground takes the
+// terminal along so Ctrl-C still reaches it, SIGTTOU would stop us while our
+// group isn't the foreground one yet
+void enterOwnGroup() {
+    if (getpgrp() == getpid()) {
+        return;     // already leading a group of our own, e.g. started with setsid
+    }
+    
+    pid_t foreground = tcgetpgrp(STDIN_FILENO);
+    bool inForeground = foreground != -1 && foreground == getpgrp();
+    
+    if (setpgid(0, 0) == -1) {
+        perror("Error creating process group");
+        return;
+    }
+    if (inForeground) {
+        void (*previous)(int) = signal(SIGTTOU, SIG_IGN);
+        if (tcsetpgrp(STDIN_FILENO, getpgrp()) == -1) {
+            perror("Error taking the terminal");
+        } else {
+            terminalGroup = foreground;
+        }
+        signal(SIGTTOU, previous);
+    }
+}
+
+// Children write their logs into the instance's output directory
+void enterOutputDir() {
+    if (outputDir[0] != '\0' && chdir(outputDir) == -1) {
+        perror("Error entering output directory");
+        exit(-1);
+    }
+}
+
+// Remember the run's options so a restore doesn't have to ask for them again
+void saveArguments(int argc, char * argv[], int algorithm, int quantum) {
+    checkpoint->algorithm = algorithm;
+    checkpoint->quantum = quantum;
+    checkpoint->argc = 0;
+    
+    for (int i = 1; i < argc && checkpoint->argc < CHECKPOINT_MAX_ARGS; i++) {
+        snprintf(checkpoint->argv[checkpoint->argc++], CHECKPOINT_ARG_LEN, "%s", argv[i]);
+    }
+    checkpoint->arrivalCursor = 0;
+}
+
+// Load the options of the checkpointed run and where to continue from
+bool loadCheckpoint(int* algorithm, int* quantum) {
+    checkpoint = openCheckpoint(checkpointPath, false);
+    if (checkpoint == NULL) {
+        return false;
+    }
+    
+    SchedulerCheckpoint* snapshot = latestSnapshot(checkpoint);
+    if (snapshot == NULL) {
+        printf("Checkpoint has no scheduler snapshot yet, nothing to restore!\n");
+        return false;
+    }
+    
+    char* args[CHECKPOINT_MAX_ARGS + 1];
+    args[0] = "process_generator.out";
+    for (int i = 0; i < checkpoint->argc; i++) {
+        args[i + 1] = checkpoint->argv[i];
+    }
+    parseArguments(checkpoint->argc + 1, args);
+    
+    *algorithm = checkpoint->algorithm;
+    *quantum = checkpoint->quantum;
+    
+    // Only what the scheduler had received counts, anything sent after its
+    // snapshot was lost with the old message queue
+    startClock = snapshot->clock;
+    arrivalCursor = snapshot->received;
+    checkpoint->arrivalCursor = arrivalCursor;
+    
+    printf("Restoring checkpoint %d: time %d, %d processes already received\n",
+           snapshot->seq, startClock, arrivalCursor);
+    return true;
+}
+
+// Prompt for the scheduling algorithm and, for Round Robin, its quantum
+bool chooseAlgorithm(int* algorithm, int* quantum) {
+    printf("\nChoose the scheduling algorithm:\n");
+    printf("1. Preemptive Highest Priority First (HPF)\n");
+    printf("2. Shortest Job Next (SJN)\n");
+    printf("3. Round Robin (RR)\n");
+    printf("4. Adaptive Round Robin (ARR)\n");
+    printf("Enter choice (1-4): ");
+    scanf("%d", algorithm);
+    
+    if (*algorithm < 1 || *algorithm > 4) {
+        printf("Invalid algorithm choice!\n");
+        return false;
+    }
+    
+    // If Round Robin, ask for quantum, adaptive RR starts from it
+    if (*algorithm == 3 || *algorithm == 4) {
+        printf("Enter time quantum for Round Robin: ");
+        scanf("%d", quantum);
+        if (*quantum <= 0) {
+            printf("Invalid quantum value!\n");
+            return false;
+        }
+    }
+    
+    return true;
+}
+
 // Read processes from input file
-int readProcesses(const char* filename, Process processes[]) {
+long long readProcesses(const char* filename) {
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
         perror("Error opening processes file");
@@ -145,27 +662,40 @@ int readProcesses(const char* filename, Process processes[]) {
     }
     
     char line[256];
-    int count = 0;
+    long long count = 0;
     
-    while (fgets(line, sizeof(line), file) != NULL && count < MAX_PROCESSES) {
+    while (fgets(line, sizeof(line), file) != NULL) {
         // Skip comments and empty lines
         if (line[0] == '#' || line[0] == '\n') {
             continue;
         }
         
-        // Parse process data
-        int result = sscanf(line, "%d\t%d\t%d\t%d", 
-                           &processes[count].id,
-                           &processes[count].arrivalTime,
-                           &processes[count].runtime,
-                           &processes[count].priority);
+        // Parse process data, the memsize and bursts columns are optional
+        Process process;
+        char bursts[128];
+        process.memsize = 0;
+        process.burstCount = 0;
+        int result = sscanf(line, "%d\t%d\t%d\t%d\t%d\t%127s", 
+                           &process.id,
+                           &process.arrivalTime,
+                           &process.runtime,
+                           &process.priority,
+                           &process.memsize,
+                           bursts);
         
-        if (result == 4) {
-            printf("Process %d: arrival=%d, runtime=%d, priority=%d\n",
-                   processes[count].id,
-                   processes[count].arrivalTime,
-                   processes[count].runtime,
-                   processes[count].priority);
+        if (result == 6 && !parseBursts(bursts, &process)) {
+            printf("Skipping process %d: invalid bursts '%s'\n", process.id, bursts);
+            continue;
+        }
+        
+        if (result >= 4) {
+            printf("Process %d: arrival=%d, runtime=%d, priority=%d, memsize=%d\n",
+                   process.id,
+                   process.arrivalTime,
+                   process.runtime,
+                   process.priority,
+                   process.memsize);
+            sorterAdd(process.arrivalTime, &process);
             count++;
         }
     }
@@ -174,38 +704,555 @@ int readProcesses(const char* filename, Process processes[]) {
     return count;
 }
 
-// Send processes to scheduler at their arrival times
-void sendProcessesToScheduler(Process processes[], int count, int msgqid) {
-    int currentProcess = 0;
+// Map trace columns, e.g. "submit=0,duration=3,priority=5" or by header name
+// "submit=submit_time,duration=runtime". submit and duration are required.
+bool parseColumnMap(const char* spec) {
+    static const char* names[COL_COUNT] = { "submit", "duration", "priority", "memsize", "id" };
+    char copy[512];
+    snprintf(copy, sizeof(copy), "%s", spec);
+    
+    for (int c = 0; c < COL_COUNT; c++) {
+        columnSpec[c][0] = '\0';
+    }
+    
+    for (char* token = strtok(copy, ","); token != NULL; token = strtok(NULL, ",")) {
+        char* value = strchr(token, '=');
+        if (value == NULL) {
+            printf("Invalid column mapping '%s', expected name=column\n", token);
+            return false;
+        }
+        *value++ = '\0';
+        
+        int c = 0;
+        while (c < COL_COUNT && strcmp(token, names[c]) != 0) {
+            c++;
+        }
+        if (c == COL_COUNT) {
+            printf("Unknown trace column '%s'\n", token);
+            return false;
+        }
+        snprintf(columnSpec[c], sizeof(columnSpec[c]), "%s", value);
+    }
+    
+    if (columnSpec[COL_SUBMIT][0] == '\0' || columnSpec[COL_DURATION][0] == '\0') {
+        printf("The trace column mapping needs at least submit and duration\n");
+        return false;
+    }
+    return true;
+}
+
+// Split a CSV line in place, returns the number of fields
+int splitFields(char* line, char* fields[], int max) {
+    int count = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    
+    char* field = line;
+    while (count < max) {
+        fields[count++] = field;
+        char* comma = strchr(field, ',');
+        if (comma == NULL) {
+            break;
+        }
+        *comma = '\0';
+        field = comma + 1;
+    }
+    return count;
+}
+
+// Stream a CSV trace of job submit time, duration and priority into the sorter
+long long readTrace(const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening trace file");
+        return 0;
+    }
+    
+    char* line = NULL;
+    size_t lineCap = 0;
+    char* fields[TRACE_MAX_FIELDS];
+    int columns[COL_COUNT];
+    long long count = 0;
+    long long skipped = 0;
+    
+    // Numeric mappings are column indices, anything else names a header column
+    bool hasHeader = false;
+    for (int c = 0; c < COL_COUNT; c++) {
+        char* end;
+        columns[c] = -1;
+        if (columnSpec[c][0] == '\0') {
+            continue;
+        }
+        columns[c] = (int)strtol(columnSpec[c], &end, 10);
+        if (*end != '\0') {
+            hasHeader = true;
+            columns[c] = -1;
+        }
+    }
+    
+    if (hasHeader) {
+        if (getline(&line, &lineCap, file) == -1) {
+            fclose(file);
+            return 0;
+        }
+        int n = splitFields(line, fields, TRACE_MAX_FIELDS);
+        for (int c = 0; c < COL_COUNT; c++) {
+            for (int f = 0; f < n && columnSpec[c][0] != '\0' && columns[c] == -1; f++) {
+                if (strcmp(fields[f], columnSpec[c]) == 0) {
+                    columns[c] = f;
+                }
+            }
+            if (columnSpec[c][0] != '\0' && columns[c] == -1) {
+                printf("Trace header has no column '%s'\n", columnSpec[c]);
+                free(line);
+                fclose(file);
+                return 0;
+            }
+        }
+    }
+    
+    while (getline(&line, &lineCap, file) != -1) {
+        int n = splitFields(line, fields, TRACE_MAX_FIELDS);
+        if (columns[COL_SUBMIT] >= n || columns[COL_DURATION] >= n) {
+            skipped++;
+            continue;
+        }
+        
+        char* endSubmit;
+        char* endDuration;
+        double submit = strtod(fields[columns[COL_SUBMIT]], &endSubmit);
+        double duration = strtod(fields[columns[COL_DURATION]], &endDuration);
+        if (endSubmit == fields[columns[COL_SUBMIT]] || endDuration == fields[columns[COL_DURATION]] ||
+            duration <= 0) {
+            skipped++;
+            continue;
+        }
+        
+        Process process;
+        process.id = (columns[COL_ID] >= 0 && columns[COL_ID] < n) ?
+                     atoi(fields[columns[COL_ID]]) : (int)(count + 1);
+        process.runtime = (int)llround(duration * timeScale);
+        if (process.runtime < 1) {
+            process.runtime = 1;
+        }
+        process.priority = (columns[COL_PRIORITY] >= 0 && columns[COL_PRIORITY] < n) ?
+                           atoi(fields[columns[COL_PRIORITY]]) : 0;
+        process.memsize = (columns[COL_MEMSIZE] >= 0 && columns[COL_MEMSIZE] < n) ?
+                          atoi(fields[columns[COL_MEMSIZE]]) : 0;
+        process.burstCount = 0;
+        process.arrivalTime = 0;    // set from the sort key once rebased
+        
+        sorterAdd(llround(submit * timeScale), &process);
+        count++;
+        
+        if (count % 1000000 == 0) {
+            printf("Imported %lld jobs...\n", count);
+        }
+    }
+    
+    if (skipped > 0) {
+        printf("Skipped %lld malformed trace lines\n", skipped);
+    }
+    
+    free(line);
+    fclose(file);
+    return count;
+}
+
+// Parse a comma separated CPU,IO,CPU,...,CPU burst list.
+// The process' runtime becomes the sum of its CPU bursts.
+bool parseBursts(char* text, Process* process) {
+    int count = 0;
+    int cpuTime = 0;
+    
+    for (char* token = strtok(text, ","); token != NULL; token = strtok(NULL, ",")) {
+        if (count == MAX_BURSTS) {
+            return false;
+        }
+        int length = atoi(token);
+        if (length <= 0) {
+            return false;
+        }
+        if (count % 2 == 0) {
+            cpuTime += length;
+        } else if (length > MAX_IO_BURST) {
+            printf("Process %d: I/O burst %d is longer than the %d ticks supported\n",
+                   process->id, length, MAX_IO_BURST);
+            return false;
+        }
+        process->bursts[count++] = length;
+    }
+    
+    // Must start and end with a CPU burst
+    if (count % 2 == 0) {
+        return false;
+    }
+    
+    if (cpuTime != process->runtime) {
+        printf("Process %d: runtime %d doesn't match its CPU bursts, using %d\n",
+               process->id, process->runtime, cpuTime);
+        process->runtime = cpuTime;
+    }
+    process->burstCount = count;
+    return true;
+}
+
+/*
+ * External merge sort
+ * Records are collected into a buffer of bounded size, each full buffer is
+ * sorted and spilled to a temporary run file. As soon as MERGE_FANIN runs of
+ * the same level exist they are merged into one run of the next level, so open
+ * files and merge buffers stay bounded however long the input is. What is left
+ * at the end is merged down until one final merge can stream the sorted output.
+ * Input that fits in one buffer never touches the disk.
+ */
+
+int compareRecords(const void* a, const void* b) {
+    const SortRecord* x = (const SortRecord*)a;
+    const SortRecord* y = (const SortRecord*)b;
+    if (x->key != y->key) {
+        return (x->key < y->key) ? -1 : 1;
+    }
+    return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+void sorterInit(size_t memoryBytes) {
+    sortBufferCap = memoryBytes / sizeof(SortRecord);
+    if (sortBufferCap < RUN_BUFFER_RECORDS) {
+        sortBufferCap = RUN_BUFFER_RECORDS;
+    }
+    sortBuffer = (SortRecord*)malloc(sizeof(SortRecord) * sortBufferCap);
+    sortBufferLen = 0;
+}
+
+void sorterAdd(long long key, Process* process) {
+    if (sortSeq > 0 && key < lastKey) {
+        outOfOrder++;
+    }
+    lastKey = key;
+    
+    if (sortBufferLen == sortBufferCap) {
+        sorterSpill();
+    }
+    
+    SortRecord* record = &sortBuffer[sortBufferLen++];
+    record->key = key;
+    record->seq = sortSeq++;
+    record->process = *process;
+}
+
+// Sort the buffer and write it out as a new run
+void sorterSpill() {
+    qsort(sortBuffer, sortBufferLen, sizeof(SortRecord), compareRecords);
+    
+    FILE* run = tmpfile();
+    if (run == NULL || fwrite(sortBuffer, sizeof(SortRecord), sortBufferLen, run) != sortBufferLen) {
+        perror("Error writing sort run");
+        exit(-1);
+    }
+    rewind(run);
+    
+    if (runCount == runCapacity) {
+        runCapacity = (runCapacity == 0) ? 16 : runCapacity * 2;
+        runFiles = (FILE**)realloc(runFiles, sizeof(FILE*) * runCapacity);
+        runLevels = (int*)realloc(runLevels, sizeof(int) * runCapacity);
+    }
+    runFiles[runCount] = run;
+    runLevels[runCount++] = 0;
+    runsSpilled++;
+    sortBufferLen = 0;
+    
+    // Levels never increase along runFiles, so the last MERGE_FANIN runs share
+    // a level when the first and the last of them do
+    while (runCount >= MERGE_FANIN &&
+           runLevels[runCount - MERGE_FANIN] == runLevels[runCount - 1]) {
+        int level = runLevels[runCount - 1];
+        FILE* merged = mergeRuns(&runFiles[runCount - MERGE_FANIN], MERGE_FANIN);
+        runCount -= MERGE_FANIN;
+        runFiles[runCount] = merged;
+        runLevels[runCount++] = level + 1;
+    }
+}
+
+bool sorterFinish() {
+    if (runCount == 0) {
+        // Everything fit in memory
+        qsort(sortBuffer, sortBufferLen, sizeof(SortRecord), compareRecords);
+        sortBufferPos = 0;
+        inMemory = true;
+        return sortBufferLen > 0;
+    }
+    
+    if (sortBufferLen > 0) {
+        sorterSpill();
+    }
+    free(sortBuffer);
+    sortBuffer = NULL;
+    
+    printf("Merging %d sorted runs...\n", runsSpilled);
+    
+    // Fewer than MERGE_FANIN runs per level are left, merge the oldest ones
+    // in place until the rest can be merged at once
+    while (runCount > MERGE_FANIN) {
+        FILE* merged = mergeRuns(runFiles, MERGE_FANIN);
+        runFiles[0] = merged;
+        memmove(&runFiles[1], &runFiles[MERGE_FANIN], sizeof(FILE*) * (runCount - MERGE_FANIN));
+        runCount -= MERGE_FANIN - 1;
+    }
+    
+    mergeOpen(runFiles, runCount);
+    return true;
+}
+
+bool sorterNext(Process* process) {
+    SortRecord record;
+    
+    if (inMemory) {
+        if (sortBufferPos == sortBufferLen) {
+            return false;
+        }
+        record = sortBuffer[sortBufferPos++];
+    } else if (!mergePop(&record)) {
+        return false;
+    }
+    
+    *process = record.process;
+    if (rebaseArrivals) {
+        if (!haveFirstKey) {
+            firstKey = record.key;
+            haveFirstKey = true;
+        }
+        process->arrivalTime = (int)(record.key - firstKey) + 1;
+    } else {
+        process->arrivalTime = (int)record.key;
+    }
+    return true;
+}
+
+// Merge a group of runs into a single new run
+FILE* mergeRuns(FILE** files, int count) {
+    FILE* out = tmpfile();
+    if (out == NULL) {
+        perror("Error creating merge run");
+        exit(-1);
+    }
+    
+    SortRecord record;
+    mergeOpen(files, count);
+    while (mergePop(&record)) {
+        fwrite(&record, sizeof(SortRecord), 1, out);
+    }
+    mergeClose();
+    
+    rewind(out);
+    return out;
+}
+
+// Refill a run's buffer, false once the run is exhausted
+bool refillRun(SortRun* run) {
+    run->len = (int)fread(run->buffer, sizeof(SortRecord), RUN_BUFFER_RECORDS, run->file);
+    run->pos = 0;
+    return run->len > 0;
+}
+
+bool runLess(int a, int b) {
+    SortRun* x = &mergeRunsState[a];
+    SortRun* y = &mergeRunsState[b];
+    return compareRecords(&x->buffer[x->pos], &y->buffer[y->pos]) < 0;
+}
+
+void siftDown(int i) {
+    while (true) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < mergeHeapSize && runLess(mergeHeap[left], mergeHeap[smallest])) {
+            smallest = left;
+        }
+        if (right < mergeHeapSize && runLess(mergeHeap[right], mergeHeap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        int tmp = mergeHeap[i];
+        mergeHeap[i] = mergeHeap[smallest];
+        mergeHeap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+void mergeOpen(FILE** files, int count) {
+    mergeRunCount = count;
+    mergeRunsState = (SortRun*)malloc(sizeof(SortRun) * count);
+    mergeHeap = (int*)malloc(sizeof(int) * count);
+    mergeHeapSize = 0;
+    
+    for (int i = 0; i < count; i++) {
+        mergeRunsState[i].file = files[i];
+        mergeRunsState[i].buffer = (SortRecord*)malloc(sizeof(SortRecord) * RUN_BUFFER_RECORDS);
+        if (refillRun(&mergeRunsState[i])) {
+            mergeHeap[mergeHeapSize++] = i;
+        }
+    }
+    for (int i = mergeHeapSize / 2 - 1; i >= 0; i--) {
+        siftDown(i);
+    }
+}
+
+bool mergePop(SortRecord* record) {
+    if (mergeHeapSize == 0) {
+        return false;
+    }
+    
+    SortRun* run = &mergeRunsState[mergeHeap[0]];
+    *record = run->buffer[run->pos++];
+    
+    if (run->pos == run->len && !refillRun(run)) {
+        mergeHeap[0] = mergeHeap[--mergeHeapSize];
+    }
+    siftDown(0);
+    return true;
+}
+
+// Free the merge buffers and close (delete) the merged runs
+void mergeClose() {
+    for (int i = 0; i < mergeRunCount; i++) {
+        free(mergeRunsState[i].buffer);
+        fclose(mergeRunsState[i].file);
+    }
+    free(mergeRunsState);
+    free(mergeHeap);
+    mergeRunsState = NULL;
+    mergeHeap = NULL;
+    mergeHeapSize = 0;
+    mergeRunCount = 0;
+}
+
+bool nextProcess(Process* process) {
+    if (openLoop) {
+        return synthesizeProcess(process);
+    }
+    return sorterNext(process);
+}
+
+/*
+ * Open-loop arrivals don't wait for the scheduler to keep up, so a rate above
+ * what it can serve shows up as growing queues instead of a slower generator.
+ * Nothing is kept per process, the generator's memory stays the same however
+ * long it runs. The same seed gives the same workload, which is how a restore
+ * finds its place in it again.
+ */
+bool synthesizeProcess(Process* process) {
+    openLoopClock += sampleDistribution(&interarrival);
+    int arrival = (int)ceil(openLoopClock);
+    if (arrival < 1) {
+        arrival = 1;
+    }
+    if (openLoopDuration > 0 && arrival > openLoopDuration) {
+        return false;
+    }
+
+    memset(process, 0, sizeof(Process));
+    process->id = openLoopNextId++;
+    process->arrivalTime = arrival;
+    process->runtime = (int)llround(sampleDistribution(&runtimeDist));
+    process->priority = (int)llround(sampleDistribution(&priorityDist));
+    process->memsize = (int)llround(sampleDistribution(&memsizeDist));
+    if (process->runtime < 1) {
+        process->runtime = 1;
+    }
+    if (process->memsize < 1) {
+        process->memsize = 1;
+    }
+    return true;
+}
+
+// "const:a", "uniform:a-b", "exp:mean" or "pareto:shape-min"
+bool parseDistribution(const char* spec, Distribution* dist) {
+    const char* colon = strchr(spec, ':');
+    if (colon == NULL) {
+        printf("Distribution '%s' needs a kind, like exp:10\n", spec);
+        return false;
+    }
+
+    int fields = sscanf(colon + 1, "%lf-%lf", &dist->a, &dist->b);
+    size_t len = colon - spec;
+    if (len == 5 && strncmp(spec, "const", len) == 0 && fields >= 1) {
+        dist->kind = DIST_CONST;
+    } else if (len == 7 && strncmp(spec, "uniform", len) == 0 && fields == 2 && dist->a <= dist->b) {
+        dist->kind = DIST_UNIFORM;
+    } else if (len == 3 && strncmp(spec, "exp", len) == 0 && fields >= 1 && dist->a > 0) {
+        dist->kind = DIST_EXP;
+    } else if (len == 6 && strncmp(spec, "pareto", len) == 0 && fields == 2 && dist->a > 0 && dist->b > 0) {
+        dist->kind = DIST_PARETO;
+    } else {
+        printf("Bad distribution '%s', use const:a, uniform:a-b, exp:mean or pareto:shape-min\n", spec);
+        return false;
+    }
+    return true;
+}
+
+double sampleDistribution(Distribution* dist) {
+    double u = drand48();
+    switch (dist->kind) {
+        case DIST_CONST:
+            return dist->a;
+        case DIST_UNIFORM:
+            return dist->a + u * (dist->b - dist->a);
+        case DIST_EXP:
+            return -dist->a * log(1 - u);
+        case DIST_PARETO:
+            return dist->b / pow(1 - u, 1 / dist->a);
+    }
+    return 0;
+}
+
+// Send processes to scheduler at their arrival times, pulling them from the
+// sorted stream one at a time
+void sendProcessesToScheduler(int msgqid) {
+    Process next;
+    bool hasNext = nextProcess(&next);
     int currentTime;
     
-    while (currentProcess < count) {
+    // After a restore skip what the scheduler already has
+    for (int i = 0; i < arrivalCursor && hasNext; i++) {
+        hasNext = nextProcess(&next);
+    }
+    
+    while (hasNext) {
         currentTime = getClk();
         
         // Send all processes that have arrived at current time
-        while (currentProcess < count && 
-               processes[currentProcess].arrivalTime <= currentTime) {
+        while (hasNext && next.arrivalTime <= currentTime) {
             
             Message msg;
             msg.mtype = 1; // Message type for new process
-            msg.process = processes[currentProcess];
+            msg.process = next;
             
             if (msgsnd(msgqid, &msg, sizeof(Process), 0) == -1) {
                 perror("Error sending process to scheduler");
             } else {
                 printf("Sent process %d to scheduler at time %d\n", 
-                       processes[currentProcess].id, currentTime);
+                       next.id, currentTime);
             }
             
-            currentProcess++;
+            arrivalCursor++;
+            if (checkpoint != NULL) {
+                checkpoint->arrivalCursor = arrivalCursor;
+            }
+            hasNext = nextProcess(&next);
         }
         
         // Small sleep to avoid busy waiting
-        if (currentProcess < count) {
+        if (hasNext) {
             usleep(100000); // 100ms
         }
     }
     
+    if (!openLoop && !inMemory) {
+        mergeClose();
+    }
+    
     // Send termination signal to scheduler (message type 2)
     Message msg;
     msg.mtype = 2;
@@ -235,6 +1282,18 @@ void clearResources(int signum) {
         kill(schedulerPid, SIGINT);
     }
     
+    if (checkpoint != NULL) {
+        closeCheckpoint(checkpoint);
+        checkpoint = NULL;
+    }
+    
+    // Hand the terminal back before signalling our own group
+    if (terminalGroup > 0) {
+        signal(SIGTTOU, SIG_IGN);
+        tcsetpgrp(STDIN_FILENO, terminalGroup);
+        terminalGroup = -1;
+    }
+    
     // Destroy clock resources
     destroyClk(true);
     
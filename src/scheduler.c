@@ -1,8 +1,41 @@
 #include "../include/headers.h"
+#include "../include/checkpoint.h"
 #include <math.h>
 #include <string.h>
-
-#define MAX_PROCESSES 100
+#include <time.h>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+// Adaptive Round Robin
+#define TUNER_WINDOW 64             // recent remaining burst times the quantum is tuned on
+#define MAX_REPLAY_JOBS 100000      // workload kept for the fixed quantum comparison
+#define MAX_REPLAY_QUANTA 64        // fixed quanta replayed at most, spread over the range
+
+// Ready waits are tracked per priority level, higher priorities share the last one
+#define WAIT_PRIORITY_LEVELS 32
+
+// Ready set mirror of the hot PCB fields, grown by doubling
+#define READY_SET_INITIAL 256
+
+// PCBs are allocated in chunks and recycled once a process finishes, so the
+// table only grows with the number of live processes
+#define PCB_CHUNK 256
+
+// Buddy memory allocator
+#define DEFAULT_MEMORY_SIZE 1024
+#define MAX_MEMORY_ORDER 20     // up to 1M units of simulated memory
+
+// Hierarchical timer wheel for I/O wakeups: 4 levels of 64 slots cover 2^24 ticks
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#if (1 << (WHEEL_BITS * WHEEL_LEVELS)) <= MAX_IO_BURST
+#error "the timer wheel can't hold the longest I/O burst"
+#endif
 
 // Process states
 typedef enum {
@@ -13,7 +46,7 @@ typedef enum {
 } ProcessState;
 
 // Process Control Block (PCB)
-typedef struct {
+typedef struct PCB {
     int id;
     int arrivalTime;
     int runtime;
@@ -24,6 +57,18 @@ typedef struct {
     int startTime;
     int finishTime;
     int lastStopTime;
+    int memsize;
+    int memStart;       // offset of the allocated buddy block, -1 if none
+    int memOrder;       // order of the allocated buddy block
+    int bursts[MAX_BURSTS];     // alternating CPU/IO lengths, even indices are CPU
+    int burstCount;
+    int burstIndex;             // current CPU burst
+    int burstRemaining;         // CPU time left in the current burst
+    int ioTime;                 // total time spent blocked on I/O
+    int ioWakeTime;             // tick at which the current I/O completes
+    struct PCB* timerNext;      // next PCB in the same timer wheel slot
+    int readySlot;              // index in the ready set, -1 if not ready
+    int readySince;             // tick the process started waiting for the CPU, memory wait included
     ProcessState state;
     pid_t pid;
     bool started;
@@ -42,6 +87,66 @@ typedef struct {
     int size;
 } Queue;
 
+// Structure-of-arrays copy of the ready queue's selection keys, so HPF and SJN
+// scan contiguous ints instead of chasing QueueNode -> PCB pointers. Removal
+// swaps in the last entry, order keeps the queue's FIFO order for tie-breaks.
+// Only READY processes are ever in it, so the state needs no mirror.
+typedef struct {
+    int* priority;      // HPF key, see hpfKey()
+    int* remaining;
+    int* arrival;
+    int* order;         // enqueue sequence number
+    PCB** pcbs;
+    int count;
+    int capacity;
+    int nextOrder;      // renumbered before it would wrap, see readySetRenumber()
+} ReadySet;
+
+// Index of the entry with the smallest (key, arrival, order), -1 if n == 0
+typedef int (*ArgminKernel)(const int* key, const int* arrival, const int* order, int n);
+
+// Metrics of the finished processes of the current rolling window
+typedef struct {
+    int start;
+    int finished;
+    double totalWTA;
+    double maxWTA;
+    long long totalWaiting;
+    int busyTicksAtStart;
+} MetricsWindow;
+
+// Sliding window of remaining CPU burst times seen when processes become ready.
+// The adaptive quantum is a percentile of it, clamped to [minQuantum, maxQuantum].
+typedef struct {
+    int samples[TUNER_WINDOW];
+    int count;
+    int next;
+    int percentile;
+    int minQuantum;
+    int maxQuantum;
+} QuantumTuner;
+
+// A finished workload entry, replayed offline to compare quanta
+typedef struct {
+    int arrivalTime;
+    int burstCount;
+    int bursts[MAX_BURSTS];
+} ReplayJob;
+
+typedef struct {
+    double avgWTA;
+    double throughput;
+    int makespan;
+} ReplayResult;
+
+// Real cost of a dispatch path measured with clock_gettime
+typedef struct {
+    const char* name;
+    long count;
+    double totalNs;
+    double maxNs;
+} DispatchTiming;
+
 // Message structure for IPC
 typedef struct {
     long mtype;
@@ -50,26 +155,113 @@ typedef struct {
         int arrivalTime;
         int runtime;
         int priority;
+        int memsize;
+        int burstCount;
+        int bursts[MAX_BURSTS];
     } process;
 } Message;
 
+// Hierarchical timer wheel. Level L slot S holds PCBs whose wake tick has
+// (tick >> (L * WHEEL_BITS)) & WHEEL_MASK == S and falls within that level's
+// range. Insert is O(1); higher levels cascade down once per lap of the level below.
+typedef struct {
+    PCB* slots[WHEEL_LEVELS][WHEEL_SIZE];
+    int now;
+    int count;
+} TimerWheel;
+
+// Buddy allocator: one free list and one bitmap per block order.
+// Free lists are doubly linked through freeNext/freePrev (indexed by block
+// offset) so a buddy can be unlinked in O(1) when it gets merged.
+typedef struct {
+    int totalSize;
+    int maxOrder;
+    int* freeHead;              // [order] -> first free block offset, -1 if empty
+    int* freeNext;              // [offset] -> next free block of the same order
+    int* freePrev;              // [offset] -> previous free block of the same order
+    unsigned char** freeMap;    // [order][offset >> order] bit set when block is free
+    int freeBytes;
+    int allocatedBytes;
+    int requestedBytes;
+} BuddyAllocator;
+
 // Global variables
 int algorithm;
 int quantum;
 int msgqid;
-PCB processes[MAX_PROCESSES];
-int processCount = 0;
+PCB* freePCBs = NULL;   // recycled PCBs, linked through timerNext
+int processCount = 0;   // live processes
+int receivedCount = 0;  // all processes received, including ones from before a restore
 Queue readyQueue;
 PCB* runningProcess = NULL;
 int currentTime = 0;
-int totalWaitingTime = 0;
-int totalRuntime = 0;
+long long totalWaitingTime = 0;
+long long totalRuntime = 0;
 double totalWTA = 0;
 double totalWTASquared = 0;
 int finishedCount = 0;
 int quantumCounter = 0;
 FILE* logFile;
 FILE* perfFile;
+FILE* memLogFile;
+BuddyAllocator memory;
+Queue pendingQueue;     // processes waiting for memory (BLOCKED)
+int memorySize = DEFAULT_MEMORY_SIZE;
+int peakAllocatedBytes = 0;
+int memoryAllocations = 0;
+int memoryFailures = 0;
+int memoryRejected = 0;    // processes larger than all of memory, never run
+TimerWheel ioWheel;     // processes blocked on I/O
+int lastTick = 0;
+int cpuBusyTicks = 0;
+int ioBusyTicks = 0;
+int overlapTicks = 0;
+bool allProcessesArrived = false;
+Checkpoint* checkpoint = NULL;
+int checkpointInterval = 0;     // ticks between snapshots, 0 disables checkpointing
+int lastCheckpointTick = 0;
+bool restoreMode = false;
+char processBinary[PATH_MAX];
+
+// Context switch overhead, charged as ticks the CPU does no useful work
+int switchCost = 0;             // ticks per start/stop/resume
+int switchBusy = 0;             // overhead ticks still to be paid before the next dispatch
+int overheadTicks = 0;
+int contextSwitches = 0;
+DispatchTiming startTiming = { "start (fork)", 0, 0, 0 };
+DispatchTiming stopTiming = { "stop (SIGSTOP)", 0, 0, 0 };
+DispatchTiming resumeTiming = { "resume (SIGCONT)", 0, 0, 0 };
+DispatchTiming selectTiming = { "select", 0, 0, 0 };
+
+// Real-time mode, see enterRealtime() in headers.h
+bool realtimeMode = false;
+RealtimeConfig realtime;
+LatencyHistogram dispatchLatency;   // clock tick until the scheduler has acted on it
+LatencyHistogram restoredJitter;    // tick jitter of the clocks before a restore
+
+// HPF aging, a process gains one priority level per agingInterval ticks in the ready queue
+int agingInterval = 0;          // 0 disables aging
+int maxReadyWait = -1;          // -1 until the first dispatch
+int maxReadyWaitId = -1;
+int maxWaitByPriority[WAIT_PRIORITY_LEVELS];
+int minPrioritySeen = INT_MAX;
+int maxPrioritySeen = INT_MIN;
+struct timespec schedulerStart;
+ReadySet readySet;
+ArgminKernel argminKernel;
+const char* argminKernelName;
+
+// Adaptive Round Robin (algorithm 4)
+QuantumTuner tuner = { {0}, 0, 0, 80, 1, 20 };
+int quantumChanges = 0;
+ReplayJob* replayJobs = NULL;
+int replayCount = 0;
+int replayCapacity = 0;
+
+// Rolling window metrics for long runs, written every windowLength ticks
+int windowLength = 0;
+MetricsWindow window;
+FILE* windowFile = NULL;
 
 // Function declarations
 void initQueue(Queue* q);
@@ -79,23 +271,100 @@ PCB* peek(Queue* q);
 bool isEmpty(Queue* q);
 void removeFromQueue(Queue* q, PCB* pcb);
 void scheduleNext();
+PCB* allocPCB();
+void freePCB(PCB* pcb);
 void startProcess(PCB* pcb);
+void makeReady(PCB* pcb);
+void enqueueReady(PCB* pcb);
+void tunerObserve(QuantumTuner* t, int remaining);
+int tunerQuantum(QuantumTuner* t);
+int compareInts(const void* a, const void* b);
+void retuneQuantum();
+void recordReplayJob(PCB* pcb);
+ReplayResult replayRoundRobin(int fixedQuantum);
+void writeQuantumComparison(FILE* file);
+void launchProcess(PCB* pcb);
+void chargeSwitch();
+void timingBegin(struct timespec* start);
+void timingEnd(DispatchTiming* timing, struct timespec* start);
+void writeTiming(FILE* file, DispatchTiming* timing);
+pid_t spawnProcess(PCB* pcb);
 void stopProcess(PCB* pcb);
 void resumeProcess(PCB* pcb);
 void finishProcess(PCB* pcb);
-void handleProcessFinish(int signum);
+void handleProcessFinish(int signum, siginfo_t* info, void* context);
 void receiveProcesses();
 void selectNextProcess();
 void writeLog(const char* state, PCB* pcb);
 void writePerformanceMetrics();
 void cleanup();
+bool buddyInit(BuddyAllocator* b, int size);
+void buddyDestroy(BuddyAllocator* b);
+int buddyAlloc(BuddyAllocator* b, int size, int* order);
+void buddyFree(BuddyAllocator* b, int offset, int order);
+int buddyLargestFree(BuddyAllocator* b);
+void buddySetFree(BuddyAllocator* b, int offset, int order, bool isFree);
+bool buddyIsFree(BuddyAllocator* b, int offset, int order);
+void buddyPush(BuddyAllocator* b, int offset, int order);
+void buddyUnlink(BuddyAllocator* b, int offset, int order);
+void admitProcess(PCB* pcb);
+void rejectProcess(PCB* pcb);
+bool allocateMemory(PCB* pcb);
+void releaseMemory(PCB* pcb);
+void admitPendingProcesses();
+void writeMemoryLog(const char* event, PCB* pcb);
+void onClockTick();
+void startIO(PCB* pcb);
+void completeIO(PCB* pcb);
+void wheelInit(TimerWheel* w, int now);
+void wheelInsert(TimerWheel* w, PCB* pcb);
+void wheelAdvance(TimerWheel* w);
+void writeCheckpoint();
+bool restoreCheckpoint();
+void saveCheckpointPCB(CheckpointPCB* rec, PCB* pcb, CheckpointQueue queue);
+bool buddyReserve(BuddyAllocator* b, int offset, int order);
 PCB* selectHPF();
 PCB* selectSJN();
 PCB* selectRR();
+PCB* scanHPF();
+PCB* scanSJN();
+int hpfKey(PCB* pcb);
+void recordReadyWait(PCB* pcb);
+void writeStarvationStats(FILE* file);
+void readySetInit(ReadySet* rs);
+void readySetAdd(ReadySet* rs, PCB* pcb);
+void readySetRemove(ReadySet* rs, PCB* pcb);
+void readySetRenumber(ReadySet* rs);
+int compareLongLongs(const void* a, const void* b);
+PCB* readySetSelect(ReadySet* rs, const int* key);
+int argminScalar(const int* key, const int* arrival, const int* order, int n);
+#ifdef HAVE_X86_KERNELS
+int argminSSE4(const int* key, const int* arrival, const int* order, int n);
+int argminAVX2(const int* key, const int* arrival, const int* order, int n);
+#endif
+void chooseArgminKernel();
+void openWindow();
+void writeWindow();
+long residentKB();
+int benchSelect();
 
 int main(int argc, char * argv[])
 {
+    clock_gettime(CLOCK_MONOTONIC, &schedulerStart);
+    chooseArgminKernel();
+
+    // Standalone benchmark of the selection paths, needs no clock or generator
+    if (argc > 1 && strcmp(argv[1], "--bench-select") == 0) {
+        return benchSelect();
+    }
+
+    realtimeMode = realtimeConfig(&realtime);
+    if (realtimeMode) {
+        enterRealtime("Scheduler", realtime.schedulerCpu, realtime.priority);
+    }
+
     initClk();
+    binaryPath(processBinary, sizeof(processBinary), "process.out");
 
     // Get parameters from command line
     if (argc < 4) {
@@ -107,28 +376,126 @@ int main(int argc, char * argv[])
     quantum = atoi(argv[2]);
     msgqid = atoi(argv[3]);
 
-    printf("Scheduler started: Algorithm=%d, Quantum=%d, MsgQID=%d\n",
-           algorithm, quantum, msgqid);
+    // Optional flags after the positional arguments
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+            memorySize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpointInterval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--restore") == 0) {
+            restoreMode = true;
+        } else if (strcmp(argv[i], "--switch-cost") == 0 && i + 1 < argc) {
+            switchCost = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quantum-min") == 0 && i + 1 < argc) {
+            tuner.minQuantum = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quantum-max") == 0 && i + 1 < argc) {
+            tuner.maxQuantum = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--aging") == 0 && i + 1 < argc) {
+            agingInterval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            windowLength = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quantum-percentile") == 0 && i + 1 < argc) {
+            tuner.percentile = atoi(argv[++i]);
+        } else {
+            printf("Warning: ignoring unknown scheduler argument '%s'\n", argv[i]);
+        }
+    }
+
+    if (tuner.minQuantum < 1 || tuner.minQuantum > tuner.maxQuantum ||
+        tuner.percentile < 1 || tuner.percentile > 100) {
+        printf("Error: need 1 <= --quantum-min <= --quantum-max and 1 <= --quantum-percentile <= 100!\n");
+        return -1;
+    }
+
+    printf("Scheduler started: Algorithm=%d, Quantum=%d, MsgQID=%d, Memory=%d\n",
+           algorithm, quantum, msgqid, memorySize);
+
+    if (!buddyInit(&memory, memorySize)) {
+        printf("Error: Memory size must be a power of two between 1 and %d!\n",
+               1 << MAX_MEMORY_ORDER);
+        return -1;
+    }
 
     // Open log files
-    logFile = fopen("scheduler.log", "w");
+    // A restored run continues the logs of the run it was checkpointed from
+    logFile = fopen("scheduler.log", restoreMode ? "a" : "w");
     if (logFile == NULL) {
         perror("Error opening log file");
         return -1;
     }
-    fprintf(logFile, "#At time x process y state arr w total z remain y wait k\n");
+    if (!restoreMode) {
+        fprintf(logFile, "#At time x process y state arr w total z remain y wait k\n");
+    }
+
+    memLogFile = fopen("memory.log", restoreMode ? "a" : "w");
+    if (memLogFile == NULL) {
+        perror("Error opening memory log file");
+        return -1;
+    }
+    if (!restoreMode) {
+        fprintf(memLogFile, "#At time x allocated/freed/blocked/rejected y bytes for process z from i to j"
+                            " free f largest l extfrag e%% intfrag n%%\n");
+    } else {
+        fprintf(logFile, "#restored from checkpoint\n");
+        fprintf(memLogFile, "#restored from checkpoint\n");
+    }
 
     // Initialize ready queue
     initQueue(&readyQueue);
+    initQueue(&pendingQueue);
+    readySetInit(&readySet);
+
+    lastTick = getClk();
+    wheelInit(&ioWheel, lastTick);
 
-    // Set up signal handler for process completion
-    signal(SIGUSR1, handleProcessFinish);
+    // The generator has already created (or validated) the checkpoint file
+    if (checkpointInterval > 0 || restoreMode) {
+        checkpoint = openCheckpoint(CHECKPOINT_FILE, false);
+        if (checkpoint == NULL) {
+            return -1;
+        }
+    }
+
+    // Set up signal handler for process completion, the sender pid tells us
+    // which process finished in case it raced with a context switch
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = handleProcessFinish;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    if (restoreMode && !restoreCheckpoint()) {
+        return -1;
+    }
+    lastCheckpointTick = lastTick;
+
+    if (windowLength > 0) {
+        windowFile = fopen("scheduler.window", restoreMode ? "a" : "w");
+        if (windowFile == NULL) {
+            perror("Error opening window metrics file");
+            return -1;
+        }
+        // A restored run carries on with the window it was checkpointed in
+        if (!restoreMode) {
+            fprintf(windowFile, "#At time t window w finished f throughput x avgWTA y maxWTA z"
+                                " avgWait k cpu u%% ready r pending p io i live l rss m KB\n");
+            openWindow();
+        } else {
+            fprintf(windowFile, "#restored from checkpoint\n");
+        }
+    }
 
     // Main scheduling loop
-    bool allProcessesArrived = false;
 
-    while (!allProcessesArrived || !isEmpty(&readyQueue) || runningProcess != NULL) {
+    while (!allProcessesArrived || !isEmpty(&readyQueue) || !isEmpty(&pendingQueue) ||
+           ioWheel.count > 0 || runningProcess != NULL) {
         currentTime = getClk();
+        bool newTick = lastTick < currentTime;
+
+        // Account every clock tick since the last iteration
+        while (lastTick < currentTime) {
+            onClockTick();
+        }
 
         // Receive new processes
         receiveProcesses();
@@ -139,12 +506,28 @@ int main(int argc, char * argv[])
             runningProcess = NULL;
         }
 
+        // Current CPU burst done, the process moves on to its I/O burst
+        if (runningProcess != NULL && runningProcess->burstRemaining <= 0 &&
+            runningProcess->burstIndex + 1 < runningProcess->burstCount) {
+            startIO(runningProcess);
+            runningProcess = NULL;
+        }
+
         // Handle Round Robin quantum expiration
-        if (algorithm == 3 && runningProcess != NULL && runningProcess->state == RUNNING) {
-            quantumCounter++;
-            if (quantumCounter >= quantum && runningProcess->remainingTime > 0) {
+        if ((algorithm == 3 || algorithm == 4) &&
+            runningProcess != NULL && runningProcess->state == RUNNING) {
+            if (quantumCounter >= quantum && runningProcess->remainingTime > 0 &&
+                isEmpty(&readyQueue)) {
+                // It would be picked again right away, no switch happens
+                // and none is paid for, it just starts a new quantum
+                tunerObserve(&tuner, runningProcess->burstRemaining);
+                if (algorithm == 4) {
+                    retuneQuantum();
+                }
+                quantumCounter = 0;
+            } else if (quantumCounter >= quantum && runningProcess->remainingTime > 0) {
                 stopProcess(runningProcess);
-                enqueue(&readyQueue, runningProcess);
+                makeReady(runningProcess);
                 runningProcess = NULL;
                 quantumCounter = 0;
             }
@@ -155,6 +538,15 @@ int main(int argc, char * argv[])
             selectNextProcess();
         }
 
+        // The selected process gets the CPU once the context switch is paid for
+        if (runningProcess != NULL && runningProcess->state != RUNNING && switchBusy == 0) {
+            launchProcess(runningProcess);
+        }
+
+        if (newTick) {
+            histogramAdd(&dispatchLatency, monotonicNs() - getClkTimestamp());
+        }
+
         // Check if all processes have arrived (received termination message)
         Message msg;
         if (msgrcv(msgqid, &msg, sizeof(msg.process), 2, IPC_NOWAIT) != -1) {
@@ -162,17 +554,21 @@ int main(int argc, char * argv[])
             printf("All processes have arrived\n");
         }
 
-        // Update waiting time for processes in ready queue
-        QueueNode* node = readyQueue.head;
-        while (node != NULL) {
-            if (node->pcb->state == READY) {
-                node->pcb->waitingTime++;
-            }
-            node = node->next;
+        if (windowFile != NULL && lastTick - window.start >= windowLength) {
+            writeWindow();
+            openWindow();
+        }
+
+        // Periodic snapshot at a point where every PCB sits in exactly one queue
+        if (checkpoint != NULL && checkpointInterval > 0 &&
+            lastTick - lastCheckpointTick >= checkpointInterval) {
+            writeCheckpoint();
+            lastCheckpointTick = lastTick;
         }
 
         // Avoid busy waiting
-        usleep(10000); // 10ms
+        // Real-time mode polls more often, the wait dominates dispatch latency
+        usleep(realtimeMode ? 1000 : 10000); // 1ms / 10ms
     }
 
     printf("All processes completed\n");
@@ -182,6 +578,7 @@ int main(int argc, char * argv[])
 
     // Close log files
     fclose(logFile);
+    fclose(memLogFile);
 
     // Clean up
     cleanup();
@@ -267,13 +664,35 @@ void receiveProcesses() {
     // Non-blocking receive of all arrived processes
     while (msgrcv(msgqid, &msg, sizeof(msg.process), 1, IPC_NOWAIT) != -1) {
         // Create PCB for new process
-        PCB* pcb = &processes[processCount++];
+        PCB* pcb = allocPCB();
         pcb->id = msg.process.id;
         pcb->arrivalTime = msg.process.arrivalTime;
-        pcb->runtime = msg.process.runtime;
         pcb->priority = msg.process.priority;
-        pcb->remainingTime = msg.process.runtime;
-        pcb->waitingTime = 0;
+        pcb->memsize = msg.process.memsize;
+        pcb->memStart = -1;
+        pcb->memOrder = -1;
+        pcb->burstCount = msg.process.burstCount;
+        if (pcb->burstCount <= 0) {
+            // Pure CPU job
+            pcb->burstCount = 1;
+            pcb->bursts[0] = msg.process.runtime;
+        } else {
+            memcpy(pcb->bursts, msg.process.bursts, sizeof(int) * pcb->burstCount);
+        }
+        // The CPU bursts are the process' runtime
+        int cpuTime = 0;
+        for (int i = 0; i < pcb->burstCount; i += 2) {
+            cpuTime += pcb->bursts[i];
+        }
+        pcb->runtime = cpuTime;
+        pcb->burstIndex = 0;
+        pcb->burstRemaining = pcb->bursts[0];
+        pcb->ioTime = 0;
+        pcb->ioWakeTime = -1;
+        pcb->timerNext = NULL;
+        pcb->remainingTime = pcb->runtime;
+        // Ticks between its arrival and this receive were spent waiting too
+        pcb->waitingTime = (lastTick > pcb->arrivalTime) ? lastTick - pcb->arrivalTime : 0;
         pcb->executionTime = 0;
         pcb->state = READY;
         pcb->pid = -1;
@@ -281,18 +700,112 @@ void receiveProcesses() {
         pcb->startTime = -1;
         pcb->lastStopTime = -1;
 
+        receivedCount++;
+        printf("Received process %d at time %d\n", pcb->id, currentTime);
+
+        if (pcb->memsize > memory.totalSize) {
+            rejectProcess(pcb);
+            continue;
+        }
+
         totalRuntime += pcb->runtime;
 
-        printf("Received process %d at time %d\n", pcb->id, currentTime);
+        if (algorithm == 4) {
+            recordReplayJob(pcb);
+        }
+
+        admitProcess(pcb);
+    }
+}
+
+// A process that can never fit in memory is dropped on arrival. It is logged
+// and counted on its own, it never runs and stays out of the other metrics.
+void rejectProcess(PCB* pcb) {
+    printf("Error: process %d needs %d bytes but memory is only %d, rejecting it\n",
+           pcb->id, pcb->memsize, memory.totalSize);
+    fprintf(logFile, "#At time %d process %d rejected, needs %d bytes of %d\n",
+            currentTime, pcb->id, pcb->memsize, memory.totalSize);
+    writeMemoryLog("rejected", pcb);
+    memoryRejected++;
+    freePCB(pcb);
+}
+
+// Move a newly arrived process to the ready queue if its memory can be
+// allocated, otherwise park it in the pending queue until memory is freed.
+void admitProcess(PCB* pcb) {
+    if (allocateMemory(pcb)) {
+        makeReady(pcb);
+        return;
+    }
+
+    pcb->state = BLOCKED;
+    pcb->readySince = lastTick;
+    memoryFailures++;
+    printf("Process %d blocked waiting for %d bytes of memory at time %d\n",
+           pcb->id, pcb->memsize, currentTime);
+    writeMemoryLog("blocked", pcb);
+    enqueue(&pendingQueue, pcb);
+}
+
+// Retry pending processes in arrival order after memory has been freed.
+// Later processes that fit may be admitted ahead of a larger one that doesn't.
+void admitPendingProcesses() {
+    QueueNode* node = pendingQueue.head;
+
+    while (node != NULL) {
+        PCB* pcb = node->pcb;
+        node = node->next;
+
+        if (allocateMemory(pcb)) {
+            // It has been waiting since it arrived, not since memory came free
+            removeFromQueue(&pendingQueue, pcb);
+            enqueueReady(pcb);
+        }
+    }
+}
+
+bool allocateMemory(PCB* pcb) {
+    if (pcb->memsize <= 0) {
+        return true;
+    }
+
+    int order;
+    int offset = buddyAlloc(&memory, pcb->memsize, &order);
+    if (offset < 0) {
+        return false;
+    }
+
+    pcb->memStart = offset;
+    pcb->memOrder = order;
+    memory.requestedBytes += pcb->memsize;
+    memoryAllocations++;
+    if (memory.allocatedBytes > peakAllocatedBytes) {
+        peakAllocatedBytes = memory.allocatedBytes;
+    }
+
+    writeMemoryLog("allocated", pcb);
+    return true;
+}
 
-        // Add to ready queue
-        enqueue(&readyQueue, pcb);
+void releaseMemory(PCB* pcb) {
+    if (pcb->memStart < 0) {
+        return;
     }
+
+    buddyFree(&memory, pcb->memStart, pcb->memOrder);
+    memory.requestedBytes -= pcb->memsize;
+    writeMemoryLog("freed", pcb);
+    pcb->memStart = -1;
+    pcb->memOrder = -1;
+
+    admitPendingProcesses();
 }
 
 void selectNextProcess() {
     PCB* selected = NULL;
+    struct timespec start;
 
+    timingBegin(&start);
     switch (algorithm) {
         case 1: // HPF
             selected = selectHPF();
@@ -304,21 +817,381 @@ void selectNextProcess() {
             selected = selectRR();
             quantumCounter = 0;
             break;
+        case 4: // Adaptive RR
+            selected = selectRR();
+            retuneQuantum();
+            quantumCounter = 0;
+            break;
     }
 
+    timingEnd(&selectTiming, &start);
+
     if (selected != NULL) {
         runningProcess = selected;
         removeFromQueue(&readyQueue, selected);
+        readySetRemove(&readySet, selected);
+        recordReadyWait(selected);
+        chargeSwitch();
+    }
+}
+
+// Put a process at the back of the ready queue
+void makeReady(PCB* pcb) {
+    pcb->readySince = lastTick;
+    enqueueReady(pcb);
+}
+
+// Same, keeping the tick the process started waiting at
+void enqueueReady(PCB* pcb) {
+    pcb->state = READY;
+    enqueue(&readyQueue, pcb);
+    readySetAdd(&readySet, pcb);
+    tunerObserve(&tuner, pcb->burstRemaining);
+}
+
+/*
+ * Adaptive Round Robin
+ * The quantum follows a percentile of the CPU time processes still needed in
+ * their current burst when they last became ready. A high percentile lets most
+ * bursts finish within one quantum, short ones can't be starved by long ones.
+ */
+
+void tunerObserve(QuantumTuner* t, int remaining) {
+    t->samples[t->next] = remaining;
+    t->next = (t->next + 1) % TUNER_WINDOW;
+    if (t->count < TUNER_WINDOW) {
+        t->count++;
+    }
+}
+
+int compareInts(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+int compareLongLongs(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+int tunerQuantum(QuantumTuner* t) {
+    if (t->count == 0) {
+        return t->minQuantum;
+    }
+
+    int sorted[TUNER_WINDOW];
+    memcpy(sorted, t->samples, sizeof(int) * t->count);
+    qsort(sorted, t->count, sizeof(int), compareInts);
+
+    int index = (t->count * t->percentile + 99) / 100 - 1;
+    if (index < 0) {
+        index = 0;
+    }
+    int q = sorted[index];
+    if (q < t->minQuantum) {
+        q = t->minQuantum;
+    }
+    if (q > t->maxQuantum) {
+        q = t->maxQuantum;
+    }
+    return q;
+}
+
+void retuneQuantum() {
+    int q = tunerQuantum(&tuner);
+    if (q == quantum) {
+        return;
+    }
+
+    printf("Quantum changed from %d to %d at time %d\n", quantum, q, lastTick);
+    fprintf(logFile, "#At time %d quantum %d -> %d\n", lastTick, quantum, q);
+    quantum = q;
+    quantumChanges++;
+}
+
+void recordReplayJob(PCB* pcb) {
+    if (replayCount == MAX_REPLAY_JOBS) {
+        return;
+    }
+    if (replayCount == replayCapacity) {
+        replayCapacity = (replayCapacity == 0) ? 256 : replayCapacity * 2;
+        replayJobs = (ReplayJob*)realloc(replayJobs, sizeof(ReplayJob) * replayCapacity);
+    }
+
+    ReplayJob* job = &replayJobs[replayCount++];
+    job->arrivalTime = pcb->arrivalTime;
+    job->burstCount = pcb->burstCount;
+    memcpy(job->bursts, pcb->bursts, sizeof(job->bursts));
+}
 
-        if (!selected->started) {
-            startProcess(selected);
+/*
+ * Replay the recorded workload through an event driven Round Robin model,
+ * with a fixed quantum or, for fixedQuantum == 0, the adaptive one. Both go
+ * through the same model so they are compared on equal terms; memory limits
+ * are not modeled.
+ */
+ReplayResult replayRoundRobin(int fixedQuantum) {
+    ReplayResult result = { 0, 0, 0 };
+    int n = replayCount;
+    if (n == 0) {
+        return result;
+    }
+
+    int* burstIndex = (int*)calloc(n, sizeof(int));
+    int* burstLeft = (int*)malloc(sizeof(int) * n);
+    int* ready = (int*)malloc(sizeof(int) * n);     // circular FIFO
+    int* blocked = (int*)malloc(sizeof(int) * n);   // min-heap on wake time
+    int* wake = (int*)malloc(sizeof(int) * n);
+    int readyHead = 0, readySize = 0, blockedSize = 0;
+    int nextArrival = 0, finished = 0;
+    double totalWTAReplay = 0;
+    QuantumTuner replayTuner = tuner;
+    replayTuner.count = 0;
+    replayTuner.next = 0;
+    int q = (fixedQuantum > 0) ? fixedQuantum : tunerQuantum(&replayTuner);
+
+    for (int i = 0; i < n; i++) {
+        burstLeft[i] = replayJobs[i].bursts[0];
+    }
+
+    int t = replayJobs[0].arrivalTime;
+
+    while (finished < n) {
+        // Admit arrivals and I/O completions up to now
+        while (nextArrival < n && replayJobs[nextArrival].arrivalTime <= t) {
+            ready[(readyHead + readySize++) % n] = nextArrival;
+            tunerObserve(&replayTuner, burstLeft[nextArrival]);
+            nextArrival++;
+        }
+        while (blockedSize > 0 && wake[blocked[0]] <= t) {
+            int j = blocked[0];
+            blocked[0] = blocked[--blockedSize];
+            for (int i = 0; 2 * i + 1 < blockedSize;) {
+                int c = 2 * i + 1;
+                if (c + 1 < blockedSize && wake[blocked[c + 1]] < wake[blocked[c]]) {
+                    c++;
+                }
+                if (wake[blocked[i]] <= wake[blocked[c]]) {
+                    break;
+                }
+                int tmp = blocked[i]; blocked[i] = blocked[c]; blocked[c] = tmp;
+                i = c;
+            }
+            ready[(readyHead + readySize++) % n] = j;
+            tunerObserve(&replayTuner, burstLeft[j]);
+        }
+
+        if (readySize == 0) {
+            // Idle until the next event
+            int next = (nextArrival < n) ? replayJobs[nextArrival].arrivalTime : -1;
+            if (blockedSize > 0 && (next == -1 || wake[blocked[0]] < next)) {
+                next = wake[blocked[0]];
+            }
+            t = next;
+            continue;
+        }
+
+        int j = ready[readyHead];
+        readyHead = (readyHead + 1) % n;
+        readySize--;
+        if (fixedQuantum == 0) {
+            q = tunerQuantum(&replayTuner);
+        }
+
+        t += switchCost;
+        int slice = (burstLeft[j] < q) ? burstLeft[j] : q;
+        t += slice;
+        burstLeft[j] -= slice;
+
+        // Whoever arrived during the slice queues up before the preempted job
+        while (nextArrival < n && replayJobs[nextArrival].arrivalTime <= t) {
+            ready[(readyHead + readySize++) % n] = nextArrival;
+            tunerObserve(&replayTuner, burstLeft[nextArrival]);
+            nextArrival++;
+        }
+
+        if (burstLeft[j] > 0) {
+            t += switchCost;
+            ready[(readyHead + readySize++) % n] = j;
+            tunerObserve(&replayTuner, burstLeft[j]);
+        } else if (burstIndex[j] + 1 < replayJobs[j].burstCount) {
+            // Off to I/O
+            t += switchCost;
+            wake[j] = t + replayJobs[j].bursts[burstIndex[j] + 1];
+            burstIndex[j] += 2;
+            burstLeft[j] = replayJobs[j].bursts[burstIndex[j]];
+            int i = blockedSize++;
+            blocked[i] = j;
+            while (i > 0 && wake[blocked[(i - 1) / 2]] > wake[blocked[i]]) {
+                int tmp = blocked[i]; blocked[i] = blocked[(i - 1) / 2]; blocked[(i - 1) / 2] = tmp;
+                i = (i - 1) / 2;
+            }
         } else {
-            resumeProcess(selected);
+            int runtime = 0;
+            for (int b = 0; b < replayJobs[j].burstCount; b += 2) {
+                runtime += replayJobs[j].bursts[b];
+            }
+            totalWTAReplay += (double)(t - replayJobs[j].arrivalTime) / runtime;
+            finished++;
+        }
+    }
+
+    result.makespan = t - replayJobs[0].arrivalTime;
+    result.avgWTA = totalWTAReplay / n;
+    result.throughput = (result.makespan > 0) ? (double)n / result.makespan : 0;
+
+    free(burstIndex);
+    free(burstLeft);
+    free(ready);
+    free(blocked);
+    free(wake);
+    return result;
+}
+
+// Adaptive quantum against every fixed quantum in its range, on the same workload
+void writeQuantumComparison(FILE* file) {
+    fprintf(file, "Adaptive quantum: %d changes, final %d, range [%d, %d] at p%d\n",
+            quantumChanges, quantum, tuner.minQuantum, tuner.maxQuantum, tuner.percentile);
+
+    if (replayCount < receivedCount - memoryRejected) {
+        fprintf(file, "Replay covers %d of %d processes\n", replayCount, receivedCount - memoryRejected);
+    }
+    if (replayCount == 0) {
+        return;
+    }
+
+    ReplayResult adaptive = replayRoundRobin(0);
+    ReplayResult best = { 0, 0, 0 };
+    int bestQuantum = 0;
+
+    // Each replay covers the whole workload. A wide range is sampled at
+    // geometrically spaced quanta, small quanta are where the results differ most
+    long long span = (long long)tuner.maxQuantum - tuner.minQuantum + 1;
+    int samples = (span > MAX_REPLAY_QUANTA) ? MAX_REPLAY_QUANTA : (int)span;
+    double ratio = (samples > 1) ? pow((double)tuner.maxQuantum / tuner.minQuantum, 1.0 / (samples - 1)) : 1;
+    int tried = 0;
+    int previous = 0;
+
+    for (int i = 0; i < samples; i++) {
+        int q = (samples == (int)span) ? tuner.minQuantum + i :
+                (int)llround(tuner.minQuantum * pow(ratio, i));
+        if (q <= previous) {
+            q = previous + 1;
+        }
+        if (q > tuner.maxQuantum) {
+            break;
+        }
+        previous = q;
+        tried++;
+        ReplayResult r = replayRoundRobin(q);
+        if (bestQuantum == 0 || r.avgWTA < best.avgWTA) {
+            best = r;
+            bestQuantum = q;
         }
     }
+
+    if (tried < span) {
+        fprintf(file, "Fixed quanta sampled: %d of %lld, geometrically spaced\n", tried, span);
+    }
+    fprintf(file, "Replay adaptive: Avg WTA = %.2f, Throughput = %.4f\n",
+            adaptive.avgWTA, adaptive.throughput);
+    fprintf(file, "Replay best fixed quantum %d: Avg WTA = %.2f, Throughput = %.4f\n",
+            bestQuantum, best.avgWTA, best.throughput);
+}
+
+/*
+ * Rolling window metrics
+ * A run that goes on for days never reaches writePerformanceMetrics() in any
+ * useful time, so with --window the metrics of the last window of ticks go to
+ * scheduler.window as the run goes.
+ */
+
+void openWindow() {
+    memset(&window, 0, sizeof(window));
+    window.start = lastTick;
+    window.busyTicksAtStart = cpuBusyTicks;
+}
+
+void writeWindow() {
+    int length = lastTick - window.start;
+    if (length <= 0) {
+        return;
+    }
+
+    double avgWTA = (window.finished > 0) ? window.totalWTA / window.finished : 0;
+    double avgWaiting = (window.finished > 0) ? (double)window.totalWaiting / window.finished : 0;
+    double cpu = (double)(cpuBusyTicks - window.busyTicksAtStart) / length * 100;
+
+    fprintf(windowFile, "At time %d window %d finished %d throughput %.4f avgWTA %.2f maxWTA %.2f"
+                        " avgWait %.2f cpu %.2f%% ready %d pending %d io %d live %d rss %ld KB\n",
+            lastTick, length, window.finished, (double)window.finished / length, avgWTA, window.maxWTA,
+            avgWaiting, cpu, readyQueue.size, pendingQueue.size, ioWheel.count, processCount, residentKB());
+    fflush(windowFile);
+}
+
+// Resident set size, to check that long runs stay flat
+long residentKB() {
+    long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) {
+        return -1;
+    }
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    fclose(statm);
+    return (resident < 0) ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Give the CPU to the selected process
+void launchProcess(PCB* pcb) {
+    if (!pcb->started) {
+        startProcess(pcb);
+    } else {
+        resumeProcess(pcb);
+    }
+}
+
+// Every start/stop/resume keeps the CPU busy for switchCost ticks
+void chargeSwitch() {
+    contextSwitches++;
+    switchBusy += switchCost;
+}
+
+void timingBegin(struct timespec* start) {
+    clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+void timingEnd(DispatchTiming* timing, struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ns = (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+    timing->count++;
+    timing->totalNs += ns;
+    if (ns > timing->maxNs) {
+        timing->maxNs = ns;
+    }
+}
+
+void writeTiming(FILE* file, DispatchTiming* timing) {
+    double avg = (timing->count > 0) ? timing->totalNs / timing->count : 0;
+    fprintf(file, "Measured %s = avg %.2f us, max %.2f us over %ld\n",
+            timing->name, avg / 1000, timing->maxNs / 1000, timing->count);
 }
 
 PCB* selectHPF() {
+    // Highest priority (lowest priority number), earliest arrival breaks ties
+    return readySetSelect(&readySet, readySet.priority);
+}
+
+PCB* selectSJN() {
+    // Shortest remaining time, earliest arrival breaks ties
+    return readySetSelect(&readySet, readySet.remaining);
+}
+
+// Linked list versions of the scans above, kept as the reference for --bench-select
+PCB* scanHPF() {
     // Find process with highest priority (lowest priority number)
     QueueNode* node = readyQueue.head;
     PCB* highest = NULL;
@@ -338,7 +1211,7 @@ PCB* selectHPF() {
     return highest;
 }
 
-PCB* selectSJN() {
+PCB* scanSJN() {
     // Find process with shortest remaining time
     QueueNode* node = readyQueue.head;
     PCB* shortest = NULL;
@@ -363,20 +1236,406 @@ PCB* selectRR() {
     return peek(&readyQueue);
 }
 
-void startProcess(PCB* pcb) {
-    currentTime = getClk();
+/*
+ * Aging without touching the queue: the effective priority of a waiting process
+ * at time t is priority - (t - readySince) / agingInterval. Between any two
+ * processes t cancels out, so ordering by priority * agingInterval + readySince
+ * is the same at every t and the key is fixed once, when the process becomes
+ * ready. That works for any ready structure ordered by a key, scan, buckets or
+ * heap, and it costs nothing per tick.
+ */
+int hpfKey(PCB* pcb) {
+    if (agingInterval <= 0) {
+        return pcb->priority;
+    }
+    return pcb->priority * agingInterval + pcb->readySince;
+}
 
-    // Fork the process
+void recordReadyWait(PCB* pcb) {
+    int wait = lastTick - pcb->readySince;
+    int level = pcb->priority;
+    if (level < 0) {
+        level = 0;
+    }
+    if (level >= WAIT_PRIORITY_LEVELS) {
+        level = WAIT_PRIORITY_LEVELS - 1;
+    }
+
+    if (wait > maxReadyWait) {
+        maxReadyWait = wait;
+        maxReadyWaitId = pcb->id;
+    }
+    if (wait > maxWaitByPriority[level]) {
+        maxWaitByPriority[level] = wait;
+    }
+    if (pcb->priority < minPrioritySeen) {
+        minPrioritySeen = pcb->priority;
+    }
+    if (pcb->priority > maxPrioritySeen) {
+        maxPrioritySeen = pcb->priority;
+    }
+}
+
+/*
+ * With aging a process that became ready at e with priority p is ahead of every
+ * process that becomes ready after e + (p - best priority) * agingInterval,
+ * so only a bounded stretch of later arrivals can overtake it.
+ */
+void writeStarvationStats(FILE* file) {
+    if (maxReadyWait >= 0) {
+        fprintf(file, "Max ready wait = %d (process %d)\n", maxReadyWait, maxReadyWaitId);
+    } else {
+        fprintf(file, "Max ready wait = none, no process was dispatched\n");
+    }
+    if (algorithm != 1 || maxPrioritySeen < minPrioritySeen) {
+        return;
+    }
+
+    if (agingInterval > 0) {
+        fprintf(file, "HPF aging = 1 level per %d ticks, later arrivals can overtake for at most %d ticks\n",
+                agingInterval, (maxPrioritySeen - minPrioritySeen) * agingInterval);
+    } else {
+        fprintf(file, "HPF aging = off, low priorities can starve\n");
+    }
+    for (int level = 0; level < WAIT_PRIORITY_LEVELS; level++) {
+        if (maxWaitByPriority[level] > 0) {
+            fprintf(file, "Max ready wait at priority %d%s = %d\n", level,
+                    (level == WAIT_PRIORITY_LEVELS - 1) ? "+" : "", maxWaitByPriority[level]);
+        }
+    }
+}
+
+void readySetInit(ReadySet* rs) {
+    memset(rs, 0, sizeof(ReadySet));
+}
+
+void readySetAdd(ReadySet* rs, PCB* pcb) {
+    if (rs->count == rs->capacity) {
+        rs->capacity = (rs->capacity == 0) ? READY_SET_INITIAL : rs->capacity * 2;
+        rs->priority = (int*)realloc(rs->priority, sizeof(int) * rs->capacity);
+        rs->remaining = (int*)realloc(rs->remaining, sizeof(int) * rs->capacity);
+        rs->arrival = (int*)realloc(rs->arrival, sizeof(int) * rs->capacity);
+        rs->order = (int*)realloc(rs->order, sizeof(int) * rs->capacity);
+        rs->pcbs = (PCB**)realloc(rs->pcbs, sizeof(PCB*) * rs->capacity);
+        if (rs->priority == NULL || rs->remaining == NULL || rs->arrival == NULL ||
+            rs->order == NULL || rs->pcbs == NULL) {
+            perror("Error growing ready set");
+            exit(-1);
+        }
+    }
+
+    if (rs->nextOrder == INT_MAX) {
+        readySetRenumber(rs);
+    }
+
+    // Keys don't change while a process waits, the running one is never in here
+    int i = rs->count++;
+    rs->priority[i] = hpfKey(pcb);
+    rs->remaining[i] = pcb->remainingTime;
+    rs->arrival[i] = pcb->arrivalTime;
+    rs->order[i] = rs->nextOrder++;
+    rs->pcbs[i] = pcb;
+    pcb->readySlot = i;
+}
+
+void readySetRemove(ReadySet* rs, PCB* pcb) {
+    int i = pcb->readySlot;
+    if (i < 0) {
+        return;
+    }
+
+    int last = --rs->count;
+    if (i != last) {
+        rs->priority[i] = rs->priority[last];
+        rs->remaining[i] = rs->remaining[last];
+        rs->arrival[i] = rs->arrival[last];
+        rs->order[i] = rs->order[last];
+        rs->pcbs[i] = rs->pcbs[last];
+        rs->pcbs[i]->readySlot = i;
+    }
+    pcb->readySlot = -1;
+}
+
+// Only the relative order of waiting processes matters, so long runs renumber
+// them 0..count-1 instead of letting the sequence number wrap
+void readySetRenumber(ReadySet* rs) {
+    long long* ranks = (long long*)malloc(sizeof(long long) * (rs->count + 1));   // + 1, count may be 0
+    if (ranks == NULL) {
+        perror("Error renumbering ready set");
+        exit(-1);
+    }
+
+    // Order in the high half, slot in the low half, sorting them sorts by order
+    for (int i = 0; i < rs->count; i++) {
+        ranks[i] = ((long long)rs->order[i] << 32) | (unsigned int)i;
+    }
+    qsort(ranks, rs->count, sizeof(long long), compareLongLongs);
+    for (int r = 0; r < rs->count; r++) {
+        rs->order[ranks[r] & 0xffffffffLL] = r;
+    }
+    rs->nextOrder = rs->count;
+    free(ranks);
+}
+
+PCB* readySetSelect(ReadySet* rs, const int* key) {
+    int i = argminKernel(key, rs->arrival, rs->order, rs->count);
+    return (i < 0) ? NULL : rs->pcbs[i];
+}
+
+int argminScalar(const int* key, const int* arrival, const int* order, int n) {
+    int best = -1;
+    for (int i = 0; i < n; i++) {
+        if (best == -1 || key[i] < key[best] ||
+            (key[i] == key[best] && (arrival[i] < arrival[best] ||
+             (arrival[i] == arrival[best] && order[i] < order[best])))) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+#ifdef HAVE_X86_KERNELS
+/*
+ * Every lane keeps its own best (key, arrival, order, index) and the lanes are
+ * reduced at the end. The lexicographic compare only needs 32 bit compares and
+ * blends, so the same loop works on SSE4.1 (4 lanes) and AVX2 (8 lanes).
+ */
+__attribute__((target("sse4.1")))
+int argminSSE4(const int* key, const int* arrival, const int* order, int n) {
+    __m128i bestKey = _mm_set1_epi32(INT_MAX);
+    __m128i bestArrival = _mm_set1_epi32(INT_MAX);
+    __m128i bestOrder = _mm_set1_epi32(INT_MAX);
+    __m128i bestIndex = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i step = _mm_set1_epi32(4);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i k = _mm_loadu_si128((const __m128i*)(key + i));
+        __m128i a = _mm_loadu_si128((const __m128i*)(arrival + i));
+        __m128i o = _mm_loadu_si128((const __m128i*)(order + i));
+
+        __m128i tie = _mm_and_si128(_mm_cmpeq_epi32(a, bestArrival), _mm_cmpgt_epi32(bestOrder, o));
+        __m128i second = _mm_or_si128(_mm_cmpgt_epi32(bestArrival, a), tie);
+        __m128i better = _mm_or_si128(_mm_cmpgt_epi32(bestKey, k),
+                                      _mm_and_si128(_mm_cmpeq_epi32(k, bestKey), second));
+
+        bestKey = _mm_blendv_epi8(bestKey, k, better);
+        bestArrival = _mm_blendv_epi8(bestArrival, a, better);
+        bestOrder = _mm_blendv_epi8(bestOrder, o, better);
+        bestIndex = _mm_blendv_epi8(bestIndex, index, better);
+        index = _mm_add_epi32(index, step);
+    }
+
+    int lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, bestIndex);
+    int best = -1;
+    for (int l = 0; l < 4; l++) {
+        int j = lanes[l];
+        if (j >= 0 && (best == -1 || key[j] < key[best] ||
+            (key[j] == key[best] && (arrival[j] < arrival[best] ||
+             (arrival[j] == arrival[best] && order[j] < order[best]))))) {
+            best = j;
+        }
+    }
+    for (; i < n; i++) {
+        if (best == -1 || key[i] < key[best] ||
+            (key[i] == key[best] && (arrival[i] < arrival[best] ||
+             (arrival[i] == arrival[best] && order[i] < order[best])))) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+__attribute__((target("avx2")))
+int argminAVX2(const int* key, const int* arrival, const int* order, int n) {
+    __m256i bestKey = _mm256_set1_epi32(INT_MAX);
+    __m256i bestArrival = _mm256_set1_epi32(INT_MAX);
+    __m256i bestOrder = _mm256_set1_epi32(INT_MAX);
+    __m256i bestIndex = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i step = _mm256_set1_epi32(8);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i k = _mm256_loadu_si256((const __m256i*)(key + i));
+        __m256i a = _mm256_loadu_si256((const __m256i*)(arrival + i));
+        __m256i o = _mm256_loadu_si256((const __m256i*)(order + i));
+
+        __m256i tie = _mm256_and_si256(_mm256_cmpeq_epi32(a, bestArrival),
+                                       _mm256_cmpgt_epi32(bestOrder, o));
+        __m256i second = _mm256_or_si256(_mm256_cmpgt_epi32(bestArrival, a), tie);
+        __m256i better = _mm256_or_si256(_mm256_cmpgt_epi32(bestKey, k),
+                                         _mm256_and_si256(_mm256_cmpeq_epi32(k, bestKey), second));
+
+        bestKey = _mm256_blendv_epi8(bestKey, k, better);
+        bestArrival = _mm256_blendv_epi8(bestArrival, a, better);
+        bestOrder = _mm256_blendv_epi8(bestOrder, o, better);
+        bestIndex = _mm256_blendv_epi8(bestIndex, index, better);
+        index = _mm256_add_epi32(index, step);
+    }
+
+    int lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, bestIndex);
+    int best = -1;
+    for (int l = 0; l < 8; l++) {
+        int j = lanes[l];
+        if (j >= 0 && (best == -1 || key[j] < key[best] ||
+            (key[j] == key[best] && (arrival[j] < arrival[best] ||
+             (arrival[j] == arrival[best] && order[j] < order[best]))))) {
+            best = j;
+        }
+    }
+    for (; i < n; i++) {
+        if (best == -1 || key[i] < key[best] ||
+            (key[i] == key[best] && (arrival[i] < arrival[best] ||
+             (arrival[i] == arrival[best] && order[i] < order[best])))) {
+            best = i;
+        }
+    }
+    return best;
+}
+#endif
+
+// Pick the widest kernel the CPU supports
+void chooseArgminKernel() {
+    argminKernel = argminScalar;
+    argminKernelName = "scalar";
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        argminKernel = argminAVX2;
+        argminKernelName = "avx2";
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        argminKernel = argminSSE4;
+        argminKernelName = "sse4.1";
+    }
+#endif
+}
+
+/*
+ * scheduler.out --bench-select
+ * Time HPF and SJN selection over 1K to 1M ready processes through the linked
+ * list scan and every argmin kernel this CPU supports. The queue is filled in
+ * shuffled PCB order, like a queue that has seen some churn.
+ */
+int benchSelect() {
+    const int sizes[] = { 1000, 10000, 100000, 1000000 };
+    ArgminKernel kernels[3] = { argminScalar };
+    const char* names[3] = { "scalar" };
+    int kernelCount = 1;
+#ifdef HAVE_X86_KERNELS
+    if (__builtin_cpu_supports("sse4.1")) {
+        kernels[kernelCount] = argminSSE4;
+        names[kernelCount++] = "sse4.1";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels[kernelCount] = argminAVX2;
+        names[kernelCount++] = "avx2";
+    }
+#endif
+
+    srand(1);
+    printf("%-8s %-4s %-8s %12s %10s\n", "ready", "key", "path", "ns/select", "ns/job");
+
+    for (int s = 0; s < 4; s++) {
+        int n = sizes[s];
+        int reps = (n <= 10000) ? 2000 : (n <= 100000 ? 200 : 20);
+
+        PCB** pcbs = (PCB**)malloc(sizeof(PCB*) * n);
+        for (int i = 0; i < n; i++) {
+            pcbs[i] = allocPCB();
+            pcbs[i]->priority = rand() % 11;
+            pcbs[i]->remainingTime = rand() % 1000 + 1;
+            pcbs[i]->arrivalTime = rand() % (n / 4 + 1);
+        }
+        for (int i = n - 1; i > 0; i--) {
+            int j = rand() % (i + 1);
+            PCB* tmp = pcbs[i]; pcbs[i] = pcbs[j]; pcbs[j] = tmp;
+        }
+
+        initQueue(&readyQueue);
+        readySetInit(&readySet);
+        for (int i = 0; i < n; i++) {
+            enqueue(&readyQueue, pcbs[i]);
+            readySetAdd(&readySet, pcbs[i]);
+        }
+
+        for (int hpf = 1; hpf >= 0; hpf--) {
+            const char* keyName = hpf ? "HPF" : "SJN";
+            const int* key = hpf ? readySet.priority : readySet.remaining;
+            struct timespec start;
+            DispatchTiming timing = { "list", 0, 0, 0 };
+            PCB* expected = NULL;
+
+            for (int r = 0; r < reps; r++) {
+                timingBegin(&start);
+                expected = hpf ? scanHPF() : scanSJN();
+                timingEnd(&timing, &start);
+            }
+            printf("%-8d %-4s %-8s %12.0f %10.3f\n", n, keyName, "list",
+                   timing.totalNs / reps, timing.totalNs / reps / n);
+
+            for (int k = 0; k < kernelCount; k++) {
+                DispatchTiming kernelTiming = { names[k], 0, 0, 0 };
+                int found = -1;
+                for (int r = 0; r < reps; r++) {
+                    timingBegin(&start);
+                    found = kernels[k](key, readySet.arrival, readySet.order, n);
+                    timingEnd(&kernelTiming, &start);
+                }
+                printf("%-8d %-4s %-8s %12.0f %10.3f%s\n", n, keyName, names[k],
+                       kernelTiming.totalNs / reps, kernelTiming.totalNs / reps / n,
+                       (readySet.pcbs[found] == expected) ? "" : "  MISMATCH");
+            }
+        }
+
+        while (!isEmpty(&readyQueue)) {
+            dequeue(&readyQueue);
+        }
+        for (int i = 0; i < n; i++) {
+            freePCB(pcbs[i]);
+        }
+        free(readySet.priority);
+        free(readySet.remaining);
+        free(readySet.arrival);
+        free(readySet.order);
+        free(readySet.pcbs);
+        free(pcbs);
+    }
+
+    return 0;
+}
+
+// Fork a process.out child that runs for the PCB's remaining time
+pid_t spawnProcess(PCB* pcb) {
     pid_t pid = fork();
 
     if (pid == 0) {
         // Child process
         char remainingTimeStr[20];
         sprintf(remainingTimeStr, "%d", pcb->remainingTime);
-        execl("./process.out", "process.out", remainingTimeStr, NULL);
+        if (realtimeMode) {
+            leaveRealtime(&realtime);
+        }
+        execl(processBinary, "process.out", remainingTimeStr, NULL);
         perror("Error executing process");
         exit(-1);
-    } else if (pid > 0) {
+    }
+    return pid;
+}
+
+void startProcess(PCB* pcb) {
+    currentTime = getClk();
+    struct timespec start;
+
+    // Fork the process
+    timingBegin(&start);
+    pid_t pid = spawnProcess(pcb);
+    timingEnd(&startTiming, &start);
+
+    if (pid > 0) {
         pcb->pid = pid;
         pcb->started = true;
         pcb->state = RUNNING;
@@ -395,7 +1654,13 @@ void stopProcess(PCB* pcb) {
     currentTime = getClk();
 
     // Send SIGSTOP to pause the process
-    kill(pcb->pid, SIGSTOP);
+    struct timespec start;
+    timingBegin(&start);
+    if (pcb->pid > 0) {
+        kill(pcb->pid, SIGSTOP);
+    }
+    timingEnd(&stopTiming, &start);
+    chargeSwitch();
 
     pcb->state = READY;
     pcb->lastStopTime = currentTime;
@@ -408,17 +1673,27 @@ void stopProcess(PCB* pcb) {
 void resumeProcess(PCB* pcb) {
     currentTime = getClk();
 
-    // Send SIGCONT to resume the process
-    kill(pcb->pid, SIGCONT);
+    if (pcb->pid == -1) {
+        // Restored from a checkpoint, the old child is gone
+        // On failure it stays selected and not RUNNING, the main loop retries
+        pid_t pid = spawnProcess(pcb);
+        if (pid < 0) {
+            perror("Error forking process");
+            return;
+        }
+        pcb->pid = pid;
+    } else {
+        // Send SIGCONT to resume the process
+        struct timespec start;
+        timingBegin(&start);
+        if (pcb->pid > 0) {
+            kill(pcb->pid, SIGCONT);
+        }
+        timingEnd(&resumeTiming, &start);
+    }
 
     pcb->state = RUNNING;
 
-    // Update waiting time
-    if (pcb->lastStopTime != -1) {
-        int waitTime = currentTime - pcb->lastStopTime;
-        pcb->waitingTime += waitTime;
-    }
-
     printf("Resumed process %d at time %d\n", pcb->id, currentTime);
 
     writeLog("resumed", pcb);
@@ -439,24 +1714,222 @@ void finishProcess(PCB* pcb) {
     totalWTASquared += (wta * wta);
     finishedCount++;
 
+    window.finished++;
+    window.totalWTA += wta;
+    window.totalWaiting += pcb->waitingTime;
+    if (wta > window.maxWTA) {
+        window.maxWTA = wta;
+    }
+
     printf("Finished process %d at time %d (TA=%d, WTA=%.2f)\n",
            pcb->id, currentTime, turnaroundTime, wta);
 
     writeLog("finished", pcb);
 
     // Terminate the process
-    kill(pcb->pid, SIGKILL);
-    waitpid(pcb->pid, NULL, 0);
+    if (pcb->pid > 0) {
+        kill(pcb->pid, SIGKILL);
+        waitpid(pcb->pid, NULL, 0);
+    }
+
+    releaseMemory(pcb);
+    freePCB(pcb);
 }
 
-void handleProcessFinish(int signum) {
+PCB* allocPCB() {
+    if (freePCBs == NULL) {
+        PCB* chunk = (PCB*)malloc(sizeof(PCB) * PCB_CHUNK);
+        if (chunk == NULL) {
+            perror("Error allocating PCBs");
+            exit(-1);
+        }
+        for (int i = 0; i < PCB_CHUNK; i++) {
+            chunk[i].timerNext = freePCBs;
+            freePCBs = &chunk[i];
+        }
+    }
+
+    PCB* pcb = freePCBs;
+    freePCBs = pcb->timerNext;
+    pcb->timerNext = NULL;
+    pcb->readySlot = -1;
+    processCount++;
+    return pcb;
+}
+
+void freePCB(PCB* pcb) {
+    pcb->timerNext = freePCBs;
+    freePCBs = pcb;
+    processCount--;
+}
+
+void handleProcessFinish(int signum, siginfo_t* info, void* context) {
     // This signal handler is called when a process sends SIGUSR1
     // We handle the actual finishing in the main loop
-    if (runningProcess != NULL) {
+    if (runningProcess != NULL && runningProcess->pid == info->si_pid) {
         runningProcess->remainingTime = 0;
     }
 }
 
+// Advance the simulation by one clock tick
+void onClockTick() {
+    lastTick++;
+
+    bool cpuBusy = runningProcess != NULL && runningProcess->state == RUNNING;
+    bool ioBusy = ioWheel.count > 0;
+
+    // Nobody runs while a context switch is being paid for
+    if (switchBusy > 0) {
+        switchBusy--;
+        overheadTicks++;
+    }
+
+    // The selected process waits for the switch to it, so TA stays wait + run + I/O
+    if (runningProcess != NULL && !cpuBusy) {
+        runningProcess->waitingTime++;
+    }
+
+    if (cpuBusy) {
+        // The process may already have reported its own completion for this tick
+        if (runningProcess->remainingTime > 0) {
+            runningProcess->remainingTime--;
+        }
+        runningProcess->executionTime++;
+        runningProcess->burstRemaining--;
+        quantumCounter++;
+        cpuBusyTicks++;
+    }
+    if (ioBusy) {
+        ioBusyTicks++;
+    }
+    if (cpuBusy && ioBusy) {
+        overlapTicks++;
+    }
+
+    // Processes waiting for the CPU or for memory
+    QueueNode* node = readyQueue.head;
+    while (node != NULL) {
+        node->pcb->waitingTime++;
+        node = node->next;
+    }
+    node = pendingQueue.head;
+    while (node != NULL) {
+        node->pcb->waitingTime++;
+        node = node->next;
+    }
+
+    // Wake up processes whose I/O completes at this tick
+    wheelAdvance(&ioWheel);
+}
+
+// Stop a process at the end of a CPU burst and block it for the following I/O burst
+void startIO(PCB* pcb) {
+    currentTime = getClk();
+
+    struct timespec start;
+    timingBegin(&start);
+    if (pcb->pid > 0) {
+        kill(pcb->pid, SIGSTOP);
+    }
+    timingEnd(&stopTiming, &start);
+    chargeSwitch();
+
+    int ioLength = pcb->bursts[pcb->burstIndex + 1];
+    if (ioLength < 1) {
+        ioLength = 1;
+    }
+    pcb->burstIndex += 2;
+    pcb->burstRemaining = pcb->bursts[pcb->burstIndex];
+    pcb->state = BLOCKED;
+    pcb->lastStopTime = lastTick;
+    pcb->ioWakeTime = lastTick + ioLength;
+    wheelInsert(&ioWheel, pcb);
+
+    printf("Process %d blocked on I/O for %d at time %d\n", pcb->id, ioLength, currentTime);
+
+    writeLog("blocked", pcb);
+}
+
+// Called by the timer wheel when a process' I/O burst is over
+void completeIO(PCB* pcb) {
+    pcb->ioTime += pcb->ioWakeTime - pcb->lastStopTime;
+    pcb->ioWakeTime = -1;
+    makeReady(pcb);
+
+    printf("Process %d finished I/O at time %d\n", pcb->id, lastTick);
+
+    writeLog("unblocked", pcb);
+}
+
+/*
+ * Timer wheel
+ * A timer lives on the lowest level whose span covers its distance from now.
+ * Every WHEEL_SIZE ticks of level L the next slot of level L + 1 is
+ * redistributed into the levels below it.
+ */
+
+void wheelInit(TimerWheel* w, int now) {
+    memset(w->slots, 0, sizeof(w->slots));
+    w->now = now;
+    w->count = 0;
+}
+
+void wheelInsert(TimerWheel* w, PCB* pcb) {
+    // A timer due right now only happens while cascading, level 0 is
+    // expired after the cascade so it still fires on this tick
+    int expires = pcb->ioWakeTime;
+    if (expires < w->now) {
+        expires = w->now;
+        pcb->ioWakeTime = expires;
+    }
+
+    int delta = expires - w->now;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1 << ((level + 1) * WHEEL_BITS))) {
+        level++;
+    }
+
+    int slot = (expires >> (level * WHEEL_BITS)) & WHEEL_MASK;
+    pcb->timerNext = w->slots[level][slot];
+    w->slots[level][slot] = pcb;
+    w->count++;
+}
+
+void wheelAdvance(TimerWheel* w) {
+    w->now++;
+
+    // Cascade higher levels when the level below wraps around
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if ((w->now & ((1 << (level * WHEEL_BITS)) - 1)) != 0) {
+            break;
+        }
+
+        int slot = (w->now >> (level * WHEEL_BITS)) & WHEEL_MASK;
+        PCB* pcb = w->slots[level][slot];
+        w->slots[level][slot] = NULL;
+
+        while (pcb != NULL) {
+            PCB* next = pcb->timerNext;
+            w->count--;
+            wheelInsert(w, pcb);
+            pcb = next;
+        }
+    }
+
+    // Expire everything in the current level 0 slot
+    int slot = w->now & WHEEL_MASK;
+    PCB* pcb = w->slots[0][slot];
+    w->slots[0][slot] = NULL;
+
+    while (pcb != NULL) {
+        PCB* next = pcb->timerNext;
+        pcb->timerNext = NULL;
+        w->count--;
+        completeIO(pcb);
+        pcb = next;
+    }
+}
+
 void writeLog(const char* state, PCB* pcb) {
     currentTime = getClk();
 
@@ -481,9 +1954,17 @@ void writePerformanceMetrics() {
         return;
     }
 
-    // CPU utilization
+    // CPU utilization, measured per tick so that time the CPU spends idle
+    // while processes are blocked on I/O is not counted as busy
     int totalTime = currentTime;
-    double cpuUtilization = (totalTime > 0) ? ((double)totalRuntime / totalTime) * 100 : 0;
+    double cpuUtilization = (totalTime > 0) ? ((double)cpuBusyTicks / totalTime) * 100 : 0;
+    double ioUtilization = (totalTime > 0) ? ((double)ioBusyTicks / totalTime) * 100 : 0;
+    double overlap = (totalTime > 0) ? ((double)overlapTicks / totalTime) * 100 : 0;
+
+    if (windowFile != NULL) {
+        writeWindow();
+        fclose(windowFile);
+    }
 
     // Average WTA
     double avgWTA = (finishedCount > 0) ? totalWTA / finishedCount : 0;
@@ -500,16 +1981,491 @@ void writePerformanceMetrics() {
     fprintf(perfFile, "Avg WTA = %.2f\n", avgWTA);
     fprintf(perfFile, "Avg Waiting = %.2f\n", avgWaiting);
     fprintf(perfFile, "Std WTA = %.2f\n", stdWTA);
+    fprintf(perfFile, "I/O utilization = %.2f%%\n", ioUtilization);
+    fprintf(perfFile, "CPU/IO overlap = %.2f%%\n", overlap);
+
+    // Where the CPU's time went: useful work, context switch overhead, idle
+    int idleTicks = totalTime - cpuBusyTicks - overheadTicks;
+    double overheadShare = (totalTime > 0) ? ((double)overheadTicks / totalTime) * 100 : 0;
+    double idleShare = (totalTime > 0) ? ((double)idleTicks / totalTime) * 100 : 0;
+    double throughput = (totalTime > 0) ? (double)finishedCount / totalTime : 0;
+    fprintf(perfFile, "Useful CPU time = %d (%.2f%%)\n", cpuBusyTicks, cpuUtilization);
+    fprintf(perfFile, "Switch overhead = %d (%.2f%%), %d switches at %d each\n",
+            overheadTicks, overheadShare, contextSwitches, switchCost);
+    fprintf(perfFile, "Idle = %d (%.2f%%)\n", idleTicks, idleShare);
+    fprintf(perfFile, "Throughput = %.4f processes per unit time\n", throughput);
+    fprintf(perfFile, "Rejected on memory = %d\n", memoryRejected);
+
+    // Real cost of the dispatch paths and of the scheduler itself
+    struct rusage usage;
+    struct timespec now;
+    getrusage(RUSAGE_SELF, &usage);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    double wallSeconds = (now.tv_sec - schedulerStart.tv_sec) +
+                         (now.tv_nsec - schedulerStart.tv_nsec) / 1e9;
+    writeTiming(perfFile, &startTiming);
+    writeTiming(perfFile, &stopTiming);
+    writeTiming(perfFile, &resumeTiming);
+    writeTiming(perfFile, &selectTiming);
+    if (realtimeMode) {
+        fprintf(perfFile, "Real-time mode: clock on CPU %d, scheduler on CPU %d, priority %d\n",
+                realtime.clockCpu, realtime.schedulerCpu, realtime.priority);
+    }
+    writeStarvationStats(perfFile);
+    LatencyHistogram jitter = restoredJitter;
+    histogramMerge(&jitter, &((ClockShared*)shmaddr)->jitter);
+    histogramWrite(perfFile, "Tick jitter", &jitter);
+    histogramWrite(perfFile, "Tick to dispatch latency", &dispatchLatency);
+    fprintf(perfFile, "Selection kernel = %s\n", argminKernelName);
+    fprintf(perfFile, "Scheduler CPU time = %.3f s (%.2f%% of %.1f s wall)\n",
+            cpuSeconds, (wallSeconds > 0) ? cpuSeconds / wallSeconds * 100 : 0, wallSeconds);
+
+    if (algorithm == 4) {
+        writeQuantumComparison(perfFile);
+    }
 
     fclose(perfFile);
 
+    // Memory summary goes at the end of the memory log
+    double peakUsage = (memory.totalSize > 0) ?
+                       ((double)peakAllocatedBytes / memory.totalSize) * 100 : 0;
+    fprintf(memLogFile, "#Memory size = %d\n", memory.totalSize);
+    fprintf(memLogFile, "#Allocations = %d\n", memoryAllocations);
+    fprintf(memLogFile, "#Processes blocked on memory = %d\n", memoryFailures);
+    fprintf(memLogFile, "#Processes rejected on memory = %d\n", memoryRejected);
+    fprintf(memLogFile, "#Peak memory usage = %.2f%%\n", peakUsage);
+
     printf("\nPerformance Metrics:\n");
     printf("CPU utilization = %.2f%%\n", cpuUtilization);
     printf("Avg WTA = %.2f\n", avgWTA);
     printf("Avg Waiting = %.2f\n", avgWaiting);
     printf("Std WTA = %.2f\n", stdWTA);
+    printf("I/O utilization = %.2f%%\n", ioUtilization);
+    printf("CPU/IO overlap = %.2f%%\n", overlap);
+    printf("Switch overhead = %.2f%%\n", overheadShare);
+    printf("Throughput = %.4f processes per unit time\n", throughput);
+}
+
+void writeMemoryLog(const char* event, PCB* pcb) {
+    currentTime = getClk();
+
+    // External fragmentation: free memory that can't serve the largest request
+    int largest = buddyLargestFree(&memory);
+    double extFrag = (memory.freeBytes > 0) ?
+                     (1.0 - (double)largest / memory.freeBytes) * 100 : 0;
+
+    // Internal fragmentation: space lost to rounding requests up to a power of two
+    int wasted = memory.allocatedBytes - memory.requestedBytes;
+    double intFrag = (memory.allocatedBytes > 0) ?
+                     ((double)wasted / memory.allocatedBytes) * 100 : 0;
+
+    fprintf(memLogFile, "At time %d %s %d bytes for process %d",
+            currentTime, event, pcb->memsize, pcb->id);
+
+    if (pcb->memStart >= 0) {
+        fprintf(memLogFile, " from %d to %d", pcb->memStart,
+                pcb->memStart + (1 << pcb->memOrder) - 1);
+    }
+
+    fprintf(memLogFile, " free %d largest %d extfrag %.2f%% intfrag %.2f%%\n",
+            memory.freeBytes, largest, extFrag, intFrag);
+    fflush(memLogFile);
+}
+
+/*
+ * Buddy allocator
+ * Memory is 2^maxOrder units. A block of order k is 2^k units and its buddy
+ * is found by flipping bit k of its offset.
+ */
+
+void buddySetFree(BuddyAllocator* b, int offset, int order, bool isFree) {
+    int index = offset >> order;
+    if (isFree) {
+        b->freeMap[order][index >> 3] |= (unsigned char)(1 << (index & 7));
+    } else {
+        b->freeMap[order][index >> 3] &= (unsigned char)~(1 << (index & 7));
+    }
+}
+
+bool buddyIsFree(BuddyAllocator* b, int offset, int order) {
+    int index = offset >> order;
+    return (b->freeMap[order][index >> 3] >> (index & 7)) & 1;
+}
+
+void buddyPush(BuddyAllocator* b, int offset, int order) {
+    b->freePrev[offset] = -1;
+    b->freeNext[offset] = b->freeHead[order];
+    if (b->freeHead[order] != -1) {
+        b->freePrev[b->freeHead[order]] = offset;
+    }
+    b->freeHead[order] = offset;
+    buddySetFree(b, offset, order, true);
+}
+
+void buddyUnlink(BuddyAllocator* b, int offset, int order) {
+    if (b->freePrev[offset] != -1) {
+        b->freeNext[b->freePrev[offset]] = b->freeNext[offset];
+    } else {
+        b->freeHead[order] = b->freeNext[offset];
+    }
+    if (b->freeNext[offset] != -1) {
+        b->freePrev[b->freeNext[offset]] = b->freePrev[offset];
+    }
+    buddySetFree(b, offset, order, false);
+}
+
+bool buddyInit(BuddyAllocator* b, int size) {
+    if (size <= 0 || (size & (size - 1)) != 0 || size > (1 << MAX_MEMORY_ORDER)) {
+        return false;
+    }
+
+    int maxOrder = 0;
+    while ((1 << maxOrder) < size) {
+        maxOrder++;
+    }
+
+    b->totalSize = size;
+    b->maxOrder = maxOrder;
+    b->freeHead = (int*)malloc(sizeof(int) * (maxOrder + 1));
+    b->freeNext = (int*)malloc(sizeof(int) * size);
+    b->freePrev = (int*)malloc(sizeof(int) * size);
+    b->freeMap = (unsigned char**)malloc(sizeof(unsigned char*) * (maxOrder + 1));
+
+    for (int order = 0; order <= maxOrder; order++) {
+        int blocks = size >> order;
+        b->freeHead[order] = -1;
+        b->freeMap[order] = (unsigned char*)calloc((blocks + 7) / 8, 1);
+    }
+
+    b->freeBytes = size;
+    b->allocatedBytes = 0;
+    b->requestedBytes = 0;
+    buddyPush(b, 0, maxOrder);
+    return true;
+}
+
+void buddyDestroy(BuddyAllocator* b) {
+    for (int order = 0; order <= b->maxOrder; order++) {
+        free(b->freeMap[order]);
+    }
+    free(b->freeMap);
+    free(b->freeHead);
+    free(b->freeNext);
+    free(b->freePrev);
+}
+
+// Returns the offset of a block of at least `size` units or -1 if none is free
+int buddyAlloc(BuddyAllocator* b, int size, int* order) {
+    int want = 0;
+    while ((1 << want) < size) {
+        want++;
+    }
+
+    // Smallest order with a free block
+    int k = want;
+    while (k <= b->maxOrder && b->freeHead[k] == -1) {
+        k++;
+    }
+    if (k > b->maxOrder) {
+        return -1;
+    }
+
+    int offset = b->freeHead[k];
+    buddyUnlink(b, offset, k);
+
+    // Split down, keeping the lower half and freeing the upper half
+    while (k > want) {
+        k--;
+        buddyPush(b, offset + (1 << k), k);
+    }
+
+    b->freeBytes -= 1 << want;
+    b->allocatedBytes += 1 << want;
+    *order = want;
+    return offset;
+}
+
+void buddyFree(BuddyAllocator* b, int offset, int order) {
+    b->freeBytes += 1 << order;
+    b->allocatedBytes -= 1 << order;
+
+    // Merge with the buddy while it is free at the same order
+    while (order < b->maxOrder) {
+        int buddy = offset ^ (1 << order);
+        if (!buddyIsFree(b, buddy, order)) {
+            break;
+        }
+        buddyUnlink(b, buddy, order);
+        offset &= ~(1 << order);
+        order++;
+    }
+
+    buddyPush(b, offset, order);
+}
+
+// Take the specific block [offset, offset + 2^order) out of the free lists,
+// used to rebuild the allocator from a checkpoint
+bool buddyReserve(BuddyAllocator* b, int offset, int order) {
+    // Find the free block that contains it
+    int k = order;
+    int base = offset;
+    while (k <= b->maxOrder && !buddyIsFree(b, base, k)) {
+        k++;
+        base = offset & ~((1 << k) - 1);
+    }
+    if (k > b->maxOrder) {
+        return false;
+    }
+
+    buddyUnlink(b, base, k);
+
+    // Split down towards the wanted block, freeing the halves that don't hold it
+    while (k > order) {
+        k--;
+        int half = 1 << k;
+        if (offset & half) {
+            buddyPush(b, base, k);
+            base += half;
+        } else {
+            buddyPush(b, base + half, k);
+        }
+    }
+
+    b->freeBytes -= 1 << order;
+    b->allocatedBytes += 1 << order;
+    return true;
+}
+
+int buddyLargestFree(BuddyAllocator* b) {
+    for (int order = b->maxOrder; order >= 0; order--) {
+        if (b->freeHead[order] != -1) {
+            return 1 << order;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Checkpointing
+ * The snapshot is taken between ticks so every live PCB is either running or
+ * in exactly one of the ready, pending or I/O sets.
+ */
+
+void saveCheckpointPCB(CheckpointPCB* rec, PCB* pcb, CheckpointQueue queue) {
+    rec->id = pcb->id;
+    rec->arrivalTime = pcb->arrivalTime;
+    rec->runtime = pcb->runtime;
+    rec->priority = pcb->priority;
+    rec->remainingTime = pcb->remainingTime;
+    rec->waitingTime = pcb->waitingTime;
+    rec->executionTime = pcb->executionTime;
+    rec->startTime = pcb->startTime;
+    rec->lastStopTime = pcb->lastStopTime;
+    rec->memsize = pcb->memsize;
+    rec->memStart = pcb->memStart;
+    rec->memOrder = pcb->memOrder;
+    memcpy(rec->bursts, pcb->bursts, sizeof(rec->bursts));
+    rec->burstCount = pcb->burstCount;
+    rec->burstIndex = pcb->burstIndex;
+    rec->burstRemaining = pcb->burstRemaining;
+    rec->ioTime = pcb->ioTime;
+    rec->ioWakeTime = pcb->ioWakeTime;
+    rec->readySince = pcb->readySince;
+    rec->started = pcb->started;
+    rec->queue = queue;
+}
+
+void writeCheckpoint() {
+    int live = (runningProcess != NULL) + readyQueue.size + pendingQueue.size + ioWheel.count;
+    SchedulerCheckpoint* slot = beginSnapshot(&checkpoint, live);
+    if (slot == NULL) {
+        printf("Warning: skipping checkpoint at time %d, no room for %d live processes\n",
+               lastTick, live);
+        return;
+    }
+
+    slot->clock = lastTick;
+    slot->received = receivedCount;
+    slot->allArrived = allProcessesArrived;
+    slot->quantumCounter = quantumCounter;
+    slot->totalWaitingTime = totalWaitingTime;
+    slot->totalRuntime = totalRuntime;
+    slot->totalWTA = totalWTA;
+    slot->totalWTASquared = totalWTASquared;
+    slot->finishedCount = finishedCount;
+    slot->cpuBusyTicks = cpuBusyTicks;
+    slot->ioBusyTicks = ioBusyTicks;
+    slot->overlapTicks = overlapTicks;
+    slot->peakAllocatedBytes = peakAllocatedBytes;
+    slot->memoryAllocations = memoryAllocations;
+    slot->memoryFailures = memoryFailures;
+    slot->memoryRejected = memoryRejected;
+    slot->switchBusy = switchBusy;
+    slot->overheadTicks = overheadTicks;
+    slot->contextSwitches = contextSwitches;
+    slot->quantum = quantum;
+    slot->quantumChanges = quantumChanges;
+    slot->tunerCount = tuner.count;
+    slot->tunerNext = tuner.next;
+    memcpy(slot->tunerSamples, tuner.samples, sizeof(slot->tunerSamples));
+    slot->maxReadyWait = maxReadyWait;
+    slot->maxReadyWaitId = maxReadyWaitId;
+    memcpy(slot->maxWaitByPriority, maxWaitByPriority, sizeof(slot->maxWaitByPriority));
+    slot->minPrioritySeen = minPrioritySeen;
+    slot->maxPrioritySeen = maxPrioritySeen;
+    slot->windowStart = window.start;
+    slot->windowFinished = window.finished;
+    slot->windowTotalWTA = window.totalWTA;
+    slot->windowMaxWTA = window.maxWTA;
+    slot->windowTotalWaiting = window.totalWaiting;
+    slot->windowBusyTicksAtStart = window.busyTicksAtStart;
+    slot->jitter = restoredJitter;
+    histogramMerge(&slot->jitter, &((ClockShared*)shmaddr)->jitter);
+    slot->dispatchLatency = dispatchLatency;
+
+    int n = 0;
+    if (runningProcess != NULL) {
+        saveCheckpointPCB(&slot->pcbs[n++], runningProcess, CKPT_RUNNING);
+    }
+    for (QueueNode* node = readyQueue.head; node != NULL; node = node->next) {
+        saveCheckpointPCB(&slot->pcbs[n++], node->pcb, CKPT_READY);
+    }
+    for (QueueNode* node = pendingQueue.head; node != NULL; node = node->next) {
+        saveCheckpointPCB(&slot->pcbs[n++], node->pcb, CKPT_PENDING);
+    }
+    // The wheel has no order worth keeping
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int i = 0; i < WHEEL_SIZE; i++) {
+            for (PCB* pcb = ioWheel.slots[level][i]; pcb != NULL; pcb = pcb->timerNext) {
+                saveCheckpointPCB(&slot->pcbs[n++], pcb, CKPT_IO);
+            }
+        }
+    }
+    slot->pcbCount = n;
+
+    publishSnapshot(checkpoint, slot);
+}
+
+bool restoreCheckpoint() {
+    SchedulerCheckpoint* slot = latestSnapshot(checkpoint);
+    if (slot == NULL) {
+        printf("Error: No complete checkpoint to restore from!\n");
+        return false;
+    }
+
+    lastTick = slot->clock;
+    currentTime = slot->clock;
+    wheelInit(&ioWheel, lastTick);
+
+    allProcessesArrived = slot->allArrived;
+    quantumCounter = slot->quantumCounter;
+    totalWaitingTime = slot->totalWaitingTime;
+    totalRuntime = slot->totalRuntime;
+    totalWTA = slot->totalWTA;
+    totalWTASquared = slot->totalWTASquared;
+    finishedCount = slot->finishedCount;
+    cpuBusyTicks = slot->cpuBusyTicks;
+    ioBusyTicks = slot->ioBusyTicks;
+    overlapTicks = slot->overlapTicks;
+    peakAllocatedBytes = slot->peakAllocatedBytes;
+    memoryAllocations = slot->memoryAllocations;
+    memoryFailures = slot->memoryFailures;
+    memoryRejected = slot->memoryRejected;
+    switchBusy = slot->switchBusy;
+    overheadTicks = slot->overheadTicks;
+    contextSwitches = slot->contextSwitches;
+    quantum = slot->quantum;
+    quantumChanges = slot->quantumChanges;
+    tuner.count = slot->tunerCount;
+    tuner.next = slot->tunerNext;
+    memcpy(tuner.samples, slot->tunerSamples, sizeof(tuner.samples));
+    maxReadyWait = slot->maxReadyWait;
+    maxReadyWaitId = slot->maxReadyWaitId;
+    memcpy(maxWaitByPriority, slot->maxWaitByPriority, sizeof(maxWaitByPriority));
+    minPrioritySeen = slot->minPrioritySeen;
+    maxPrioritySeen = slot->maxPrioritySeen;
+    window.start = slot->windowStart;
+    window.finished = slot->windowFinished;
+    window.totalWTA = slot->windowTotalWTA;
+    window.maxWTA = slot->windowMaxWTA;
+    window.totalWaiting = slot->windowTotalWaiting;
+    window.busyTicksAtStart = slot->windowBusyTicksAtStart;
+    restoredJitter = slot->jitter;
+    dispatchLatency = slot->dispatchLatency;
+
+    // Finished processes are only kept as metrics, live ones get a fresh table
+    for (int i = 0; i < slot->pcbCount; i++) {
+        CheckpointPCB* rec = &slot->pcbs[i];
+        PCB* pcb = allocPCB();
+
+        pcb->id = rec->id;
+        pcb->arrivalTime = rec->arrivalTime;
+        pcb->runtime = rec->runtime;
+        pcb->priority = rec->priority;
+        pcb->remainingTime = rec->remainingTime;
+        pcb->waitingTime = rec->waitingTime;
+        pcb->executionTime = rec->executionTime;
+        pcb->startTime = rec->startTime;
+        pcb->finishTime = -1;
+        pcb->lastStopTime = rec->lastStopTime;
+        pcb->memsize = rec->memsize;
+        pcb->memStart = rec->memStart;
+        pcb->memOrder = rec->memOrder;
+        memcpy(pcb->bursts, rec->bursts, sizeof(pcb->bursts));
+        pcb->burstCount = rec->burstCount;
+        pcb->burstIndex = rec->burstIndex;
+        pcb->burstRemaining = rec->burstRemaining;
+        pcb->ioTime = rec->ioTime;
+        pcb->ioWakeTime = rec->ioWakeTime;
+        pcb->readySince = rec->readySince;
+        pcb->timerNext = NULL;
+        pcb->started = rec->started;
+        pcb->pid = -1;
+
+        if (pcb->memStart >= 0 && !buddyReserve(&memory, pcb->memStart, pcb->memOrder)) {
+            printf("Error: Checkpoint memory block of process %d overlaps another one!\n", pcb->id);
+            return false;
+        }
+        if (pcb->memStart >= 0) {
+            memory.requestedBytes += pcb->memsize;
+        }
+
+        switch (rec->queue) {
+            case CKPT_RUNNING:
+                pcb->state = READY;
+                runningProcess = pcb;
+                break;
+            case CKPT_READY:
+                pcb->state = READY;
+                enqueue(&readyQueue, pcb);
+                readySetAdd(&readySet, pcb);
+                break;
+            case CKPT_PENDING:
+                pcb->state = BLOCKED;
+                enqueue(&pendingQueue, pcb);
+                break;
+            case CKPT_IO:
+                pcb->state = BLOCKED;
+                wheelInsert(&ioWheel, pcb);
+                break;
+        }
+    }
+
+    printf("Restored %d live processes (%d finished) from checkpoint %d at time %d\n",
+           processCount, finishedCount, slot->seq, lastTick);
+
+    // The running process gets a new child from the main loop once any
+    // pending switch overhead is paid
+    receivedCount = slot->received;
+    return true;
 }
 
 void cleanup() {
+    if (checkpoint != NULL) {
+        closeCheckpoint(checkpoint);
+    }
+    buddyDestroy(&memory);
     printf("Scheduler cleanup complete\n");
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ struct processData
     int priority;
     int runningtime;
     int id;
+    int memsize;
 };
 
 int main(int argc, char * argv[])
@@ -21,7 +22,7 @@ int main(int argc, char * argv[])
     scanf("%d", &no);
     srand(time(null));
     //fprintf(pFile,"%d\n",no);
-    fprintf(pFile, "#id arrival runtime priority\n");
+    fprintf(pFile, "#id arrival runtime priority memsize\n");
     pData.arrivaltime = 1;
     for (int i = 1 ; i <= no ; i++)
     {
@@ -31,7 +32,8 @@ int main(int argc, char * argv[])
         pData.arrivaltime += rand() % (11); //processes arrives in order
         pData.runningtime = rand() % (30);
         pData.priority = rand() % (11);
-        fprintf(pFile, "%d\t%d\t%d\t%d\n", pData.id, pData.arrivaltime, pData.runningtime, pData.priority);
+        pData.memsize = rand() % (256) + 1;
+        fprintf(pFile, "%d\t%d\t%d\t%d\t%d\n", pData.id, pData.arrivaltime, pData.runningtime, pData.priority, pData.memsize);
     }
     fclose(pFile);
 }
@@ -0,0 +1,575 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+
+/*
+ * Gantt timeline of a scheduler.log as SVG or Chrome trace-event JSON
+ * (open in chrome://tracing or ui.perfetto.dev).
+ *
+ * The log is read twice, once for the time and id range and once to build a
+ * grid of time buckets by rows: the CPU, then the processes, several per row
+ * when there are more processes than rows. Each cell only keeps how many ticks
+ * were spent running, ready and blocked, so memory depends on the grid size
+ * and the number of live processes, not on the length of the log. Neighbouring
+ * cells that look the same are merged when the grid is written.
+ */
+
+#define DEFAULT_BUCKETS 1000
+#define DEFAULT_ROWS 64
+#define MAX_BUCKETS 100000
+#define MAX_ROWS 10000
+#define SHADES 4                // opacity levels for partly filled cells
+
+#define LABEL_WIDTH 90
+#define PLOT_WIDTH 1200
+#define ROW_HEIGHT 14
+#define AXIS_HEIGHT 30
+
+typedef enum {
+    IDLE,
+    RUNNING,
+    READY,
+    BLOCKED
+} SliceState;
+
+// Ticks spent in each state within one bucket of one row
+typedef struct {
+    int running;
+    int ready;
+    int blocked;
+    int pid;            // CPU row: process with the longest stretch in the bucket
+    int pidTicks;
+} Cell;
+
+// Open interval of a live process, keyed by id in an open addressing table
+typedef struct {
+    int id;
+    int slot;           // SLOT_EMPTY, SLOT_USED or SLOT_DELETED, any id is valid
+    int state;
+    int since;
+} LiveProcess;
+
+enum { SLOT_EMPTY, SLOT_USED, SLOT_DELETED };
+
+// A run of merged cells waiting to be written
+typedef struct {
+    int row;
+    int first;
+    int last;
+    int key;            // state, or pid on the CPU row
+    int shade;          // 0 for nothing to draw
+} Slice;
+
+// Options
+const char* inputFile = "scheduler.log";
+const char* outputFile = NULL;
+bool jsonOutput = false;
+int maxBuckets = DEFAULT_BUCKETS;
+int maxRows = DEFAULT_ROWS;
+
+// Log range, from the first pass
+int minTime = INT_MAX;
+int maxTime = INT_MIN;
+int minId = INT_MAX;
+int maxId = INT_MIN;
+long long eventCount = 0;
+
+// Grid
+Cell* grid = NULL;
+int bucketCount;
+int bucketWidth;
+int processRows;
+long long idsPerRow;    // the id range can be wider than an int
+
+LiveProcess* live = NULL;
+int liveCapacity = 0;
+int liveUsed = 0;       // live and deleted slots
+
+FILE* out;
+long long slicesWritten = 0;
+
+// Function declarations
+bool parseArguments(int argc, char * argv[]);
+bool parseLine(const char* line, int* time, int* id, char* state, int* arrival);
+bool scanRange();
+bool buildGrid();
+LiveProcess* liveFind(int id, bool insert);
+void liveGrow();
+void addInterval(int id, int state, int from, int to);
+int rowOf(int id);
+void rowLabel(int row, char* label, size_t size);
+Cell* cellAt(int row, int bucket);
+void cellClass(int row, int bucket, int* key, int* shade);
+void writeGrid();
+void writeHeader();
+void writeSlice(Slice* slice);
+void writeFooter();
+const char* stateName(int state);
+const char* stateColor(int state);
+
+
+int main(int argc, char * argv[])
+{
+    if (!parseArguments(argc, argv)) {
+        return -1;
+    }
+
+    if (!scanRange()) {
+        return -1;
+    }
+    if (eventCount == 0) {
+        printf("No events in %s\n", inputFile);
+        return -1;
+    }
+
+    // Level of detail: as many ticks per bucket as it takes to fit maxBuckets
+    int span = maxTime - minTime + 1;
+    bucketWidth = (span + maxBuckets - 1) / maxBuckets;
+    bucketCount = (span + bucketWidth - 1) / bucketWidth;
+
+    long long ids = (long long)maxId - minId + 1;
+    idsPerRow = (ids + maxRows - 1) / maxRows;
+    processRows = (int)((ids + idsPerRow - 1) / idsPerRow);
+
+    grid = (Cell*)calloc((size_t)(processRows + 1) * bucketCount, sizeof(Cell));
+    if (grid == NULL) {
+        perror("Error allocating timeline grid");
+        return -1;
+    }
+
+    if (!buildGrid()) {
+        return -1;
+    }
+
+    out = fopen(outputFile, "w");
+    if (out == NULL) {
+        perror("Error opening output file");
+        return -1;
+    }
+    writeGrid();
+    fclose(out);
+
+    printf("%lld events, times %d-%d, processes %d-%d\n", eventCount, minTime, maxTime, minId, maxId);
+    printf("%d buckets of %d ticks, %d process rows of %lld processes\n",
+           bucketCount, bucketWidth, processRows, idsPerRow);
+    printf("Wrote %lld slices to %s\n", slicesWritten, outputFile);
+
+    free(grid);
+    free(live);
+    return 0;
+}
+
+bool parseArguments(int argc, char * argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "json") == 0) {
+                jsonOutput = true;
+            } else if (strcmp(argv[i], "svg") == 0) {
+                jsonOutput = false;
+            } else {
+                printf("Error: unknown format '%s', use svg or json!\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--buckets") == 0 && i + 1 < argc) {
+            maxBuckets = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            maxRows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (argv[i][0] != '-') {
+            inputFile = argv[i];
+        } else {
+            printf("Usage: %s [scheduler.log] [--format svg|json] [--buckets n] [--rows n] [-o file]\n",
+                   argv[0]);
+            return false;
+        }
+    }
+
+    if (maxBuckets < 1 || maxBuckets > MAX_BUCKETS || maxRows < 1 || maxRows > MAX_ROWS) {
+        printf("Error: --buckets must be 1-%d and --rows 1-%d!\n", MAX_BUCKETS, MAX_ROWS);
+        return false;
+    }
+    if (outputFile == NULL) {
+        outputFile = jsonOutput ? "timeline.json" : "timeline.svg";
+    }
+    return true;
+}
+
+// "At time t process id state arr a ..." lines, comments and anything else are skipped
+bool parseLine(const char* line, int* time, int* id, char* state, int* arrival) {
+    return sscanf(line, "At time %d process %d %15s arr %d", time, id, state, arrival) == 4;
+}
+
+// First pass: time and id range
+bool scanRange() {
+    FILE* file = fopen(inputFile, "r");
+    if (file == NULL) {
+        perror("Error opening log file");
+        return false;
+    }
+
+    char line[512];
+    char state[16];
+    int time, id, arrival;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (!parseLine(line, &time, &id, state, &arrival)) {
+            continue;
+        }
+        eventCount++;
+        if (arrival < minTime) minTime = arrival;
+        if (time > maxTime) maxTime = time;
+        if (id < minId) minId = id;
+        if (id > maxId) maxId = id;
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Second pass: replay the state changes into the grid
+bool buildGrid() {
+    FILE* file = fopen(inputFile, "r");
+    if (file == NULL) {
+        perror("Error opening log file");
+        return false;
+    }
+
+    char line[512];
+    char state[16];
+    int time, id, arrival;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (!parseLine(line, &time, &id, state, &arrival)) {
+            continue;
+        }
+
+        LiveProcess* p = liveFind(id, true);
+        if (p->state == IDLE) {
+            // First event of the process, it has been waiting since it arrived
+            p->state = READY;
+            p->since = arrival;
+        }
+        addInterval(id, p->state, p->since, time);
+        p->since = time;
+
+        if (strcmp(state, "started") == 0 || strcmp(state, "resumed") == 0) {
+            p->state = RUNNING;
+        } else if (strcmp(state, "stopped") == 0 || strcmp(state, "unblocked") == 0) {
+            p->state = READY;
+        } else if (strcmp(state, "blocked") == 0) {
+            p->state = BLOCKED;
+        } else if (strcmp(state, "finished") == 0) {
+            p->slot = SLOT_DELETED;
+        }
+    }
+    fclose(file);
+
+    // A log that was cut off leaves processes running, ready or blocked,
+    // their last interval lasts until the end of the log
+    for (int i = 0; i < liveCapacity; i++) {
+        LiveProcess* p = &live[i];
+        if (p->slot == SLOT_USED && p->state != IDLE) {
+            addInterval(p->id, p->state, p->since, maxTime + 1);
+        }
+    }
+    return true;
+}
+
+LiveProcess* liveFind(int id, bool insert) {
+    if (liveUsed * 2 >= liveCapacity) {
+        liveGrow();
+    }
+
+    unsigned int mask = liveCapacity - 1;
+    unsigned int i = ((unsigned int)id * 2654435761u) & mask;
+    LiveProcess* tombstone = NULL;
+
+    while (live[i].slot != SLOT_EMPTY) {
+        if (live[i].slot == SLOT_USED && live[i].id == id) {
+            return &live[i];
+        }
+        if (live[i].slot == SLOT_DELETED && tombstone == NULL) {
+            tombstone = &live[i];
+        }
+        i = (i + 1) & mask;
+    }
+    if (!insert) {
+        return NULL;
+    }
+
+    LiveProcess* slot = (tombstone != NULL) ? tombstone : &live[i];
+    if (tombstone == NULL) {
+        liveUsed++;
+    }
+    slot->id = id;
+    slot->slot = SLOT_USED;
+    slot->state = IDLE;
+    slot->since = 0;
+    return slot;
+}
+
+// Double the table, or just drop the deleted slots when most of it is deleted
+void liveGrow() {
+    LiveProcess* old = live;
+    int oldCapacity = liveCapacity;
+    int count = 0;
+
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].slot == SLOT_USED) {
+            count++;
+        }
+    }
+
+    liveCapacity = (oldCapacity == 0) ? 1024 : oldCapacity;
+    while (count * 4 >= liveCapacity) {
+        liveCapacity *= 2;
+    }
+    live = (LiveProcess*)calloc(liveCapacity, sizeof(LiveProcess));
+    if (live == NULL) {
+        perror("Error allocating process table");
+        exit(-1);
+    }
+    liveUsed = 0;
+
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].slot == SLOT_USED) {
+            *liveFind(old[i].id, true) = old[i];
+        }
+    }
+    free(old);
+}
+
+// Spread [from, to) over the buckets it covers, running time also counts for the CPU row
+void addInterval(int id, int state, int from, int to) {
+    if (to <= from || state == IDLE) {
+        return;
+    }
+
+    int row = rowOf(id);
+    for (int b = (from - minTime) / bucketWidth; b <= (to - 1 - minTime) / bucketWidth; b++) {
+        int start = minTime + b * bucketWidth;
+        int end = start + bucketWidth;
+        int ticks = ((to < end) ? to : end) - ((from > start) ? from : start);
+
+        Cell* cell = cellAt(row, b);
+        if (state == RUNNING) {
+            cell->running += ticks;
+
+            Cell* cpu = cellAt(0, b);
+            cpu->running += ticks;
+            if (cpu->pid == id) {
+                cpu->pidTicks += ticks;
+            } else if (ticks > cpu->pidTicks) {
+                cpu->pid = id;
+                cpu->pidTicks = ticks;
+            }
+        } else if (state == READY) {
+            cell->ready += ticks;
+        } else {
+            cell->blocked += ticks;
+        }
+    }
+}
+
+int rowOf(int id) {
+    return 1 + (int)(((long long)id - minId) / idsPerRow);
+}
+
+void rowLabel(int row, char* label, size_t size) {
+    if (row == 0) {
+        snprintf(label, size, "CPU");
+        return;
+    }
+
+    long long first = minId + (row - 1) * idsPerRow;
+    long long last = first + idsPerRow - 1;
+    if (last > maxId) {
+        last = maxId;
+    }
+    if (first == last) {
+        snprintf(label, size, "P%lld", first);
+    } else {
+        snprintf(label, size, "P%lld-%lld", first, last);
+    }
+}
+
+Cell* cellAt(int row, int bucket) {
+    return &grid[(size_t)row * bucketCount + bucket];
+}
+
+/*
+ * What a cell shows: the process on the CPU row, the state the row's processes
+ * spent most of the bucket in otherwise. The shade is how full the cell is, an
+ * empty cell has shade 0 whatever its key, so pid 0 is a pid like any other.
+ */
+void cellClass(int row, int bucket, int* key, int* shade) {
+    Cell* cell = cellAt(row, bucket);
+    int ticks;
+
+    if (row == 0) {
+        *key = (cell->running > 0) ? cell->pid : 0;
+        ticks = cell->running;
+    } else if (cell->running >= cell->ready && cell->running >= cell->blocked) {
+        *key = (cell->running > 0) ? RUNNING : IDLE;
+        ticks = cell->running;
+    } else if (cell->blocked >= cell->ready) {
+        *key = BLOCKED;
+        ticks = cell->blocked;
+    } else {
+        *key = READY;
+        ticks = cell->ready;
+    }
+
+    long long capacity = bucketWidth * ((row == 0) ? 1 : idsPerRow);
+    *shade = (int)(((long long)ticks * SHADES + capacity - 1) / capacity);
+    if (*shade > SHADES) {
+        *shade = SHADES;
+    }
+}
+
+// Walk the grid row by row, merging equal neighbours into slices
+void writeGrid() {
+    writeHeader();
+
+    for (int row = 0; row <= processRows; row++) {
+        Slice slice = { row, 0, -1, 0, 0 };
+
+        for (int b = 0; b < bucketCount; b++) {
+            int key, shade;
+            cellClass(row, b, &key, &shade);
+
+            if (slice.last == b - 1 && key == slice.key && shade == slice.shade) {
+                slice.last = b;
+                continue;
+            }
+            if (slice.shade != 0) {
+                writeSlice(&slice);
+            }
+            slice.first = slice.last = b;
+            slice.key = key;
+            slice.shade = shade;
+        }
+        if (slice.shade != 0) {
+            writeSlice(&slice);
+        }
+    }
+
+    writeFooter();
+}
+
+void writeHeader() {
+    int rows = processRows + 1;
+
+    if (jsonOutput) {
+        // One tick shows as one millisecond
+        fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+        fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Processes\"}}");
+        for (int row = 1; row < rows; row++) {
+            char label[32];
+            rowLabel(row, label, sizeof(label));
+            fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                         "\"args\":{\"name\":\"%s\"}}", row, label);
+        }
+        return;
+    }
+
+    int height = AXIS_HEIGHT + rows * ROW_HEIGHT + 20;
+    fprintf(out, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+                 "font-family=\"monospace\" font-size=\"10\">\n", LABEL_WIDTH + PLOT_WIDTH + 10, height);
+    fprintf(out, "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+
+    // Time axis with ten divisions
+    for (int i = 0; i <= 10; i++) {
+        double x = LABEL_WIDTH + PLOT_WIDTH * i / 10.0;
+        int t = minTime + (int)((long long)bucketCount * bucketWidth * i / 10);
+        fprintf(out, "<line x1=\"%.1f\" y1=\"%d\" x2=\"%.1f\" y2=\"%d\" stroke=\"#ddd\"/>"
+                     "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">%d</text>\n",
+                x, AXIS_HEIGHT - 5, x, AXIS_HEIGHT + rows * ROW_HEIGHT, x, AXIS_HEIGHT - 10, t);
+    }
+    for (int row = 0; row < rows; row++) {
+        char label[32];
+        rowLabel(row, label, sizeof(label));
+        fprintf(out, "<text x=\"4\" y=\"%d\">%s</text>\n", AXIS_HEIGHT + row * ROW_HEIGHT + 10, label);
+    }
+
+    int legendY = AXIS_HEIGHT + rows * ROW_HEIGHT + 14;
+    for (int state = RUNNING; state <= BLOCKED; state++) {
+        int x = LABEL_WIDTH + (state - RUNNING) * 90;
+        fprintf(out, "<rect x=\"%d\" y=\"%d\" width=\"10\" height=\"10\" fill=\"%s\"/>"
+                     "<text x=\"%d\" y=\"%d\">%s</text>\n",
+                x, legendY - 9, stateColor(state), x + 14, legendY, stateName(state));
+    }
+    fprintf(out, "<text x=\"%d\" y=\"%d\">%d ticks per bucket</text>\n",
+            LABEL_WIDTH + 300, legendY, bucketWidth);
+}
+
+void writeSlice(Slice* slice) {
+    int start = minTime + slice->first * bucketWidth;
+    int end = minTime + (slice->last + 1) * bucketWidth;
+    char label[32];
+    rowLabel(slice->row, label, sizeof(label));
+    slicesWritten++;
+
+    if (jsonOutput) {
+        if (slice->row == 0) {
+            fprintf(out, ",\n{\"name\":\"P%d\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%lld,\"dur\":%lld,"
+                         "\"args\":{\"share\":%.2f}}",
+                    slice->key, start * 1000LL, (end - start) * 1000LL, (double)slice->shade / SHADES);
+        } else {
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+                         "\"args\":{\"share\":%.2f}}",
+                    stateName(slice->key), slice->row, start * 1000LL, (end - start) * 1000LL,
+                    (double)slice->shade / SHADES);
+        }
+        return;
+    }
+
+    double scale = (double)PLOT_WIDTH / bucketCount;
+    double x = LABEL_WIDTH + slice->first * scale;
+    double width = (slice->last - slice->first + 1) * scale;
+    int y = AXIS_HEIGHT + slice->row * ROW_HEIGHT + 1;
+
+    if (slice->row == 0) {
+        // Each process gets its own hue on the CPU row
+        fprintf(out, "<rect x=\"%.2f\" y=\"%d\" width=\"%.2f\" height=\"%d\" fill=\"hsl(%d,65%%,50%%)\" "
+                     "fill-opacity=\"%.2f\"><title>P%d %d-%d</title></rect>\n",
+                x, y, width, ROW_HEIGHT - 2, (int)(((long long)slice->key * 47 % 360 + 360) % 360),
+                (double)slice->shade / SHADES, slice->key, start, end);
+    } else {
+        fprintf(out, "<rect x=\"%.2f\" y=\"%d\" width=\"%.2f\" height=\"%d\" fill=\"%s\" "
+                     "fill-opacity=\"%.2f\"><title>%s %s %d-%d</title></rect>\n",
+                x, y, width, ROW_HEIGHT - 2, stateColor(slice->key),
+                (double)slice->shade / SHADES, label, stateName(slice->key), start, end);
+    }
+}
+
+void writeFooter() {
+    if (jsonOutput) {
+        fprintf(out, "\n]}\n");
+    } else {
+        fprintf(out, "</svg>\n");
+    }
+}
+
+const char* stateName(int state) {
+    switch (state) {
+        case RUNNING: return "running";
+        case READY: return "ready";
+        case BLOCKED: return "blocked";
+        default: return "idle";
+    }
+}
+
+const char* stateColor(int state) {
+    switch (state) {
+        case RUNNING: return "#2e7d32";
+        case READY: return "#f9a825";
+        case BLOCKED: return "#1565c0";
+        default: return "#ffffff";
+    }
+}